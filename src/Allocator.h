@@ -0,0 +1,170 @@
+#ifndef LIBQCH5_ALLOCATOR_H
+#define LIBQCH5_ALLOCATOR_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+
+namespace libqch5 {
+
+/// Raw allocation routines backing the allocators below.  Zero length
+/// requests return a null pointer and releasing a null pointer is a no-op.
+namespace Memory {
+
+   /// Returns a block of bytes aligned to alignment, which must be a power of
+   /// two and a multiple of sizeof(void*).  Throws std::bad_alloc on failure.
+   void* alignedAllocate(size_t bytes, size_t alignment);
+   void  alignedRelease(void* p);
+
+   /// Granularity of huge page allocations.
+   size_t const HugePageSize = 2 << 20;
+
+   /// Returns memory backed by huge pages where the system allows.  Requests
+   /// smaller than HugePageSize are served by alignedAllocate.  The same
+   /// byte count must be passed to hugePageRelease.
+   void* hugePageAllocate(size_t bytes);
+   void  hugePageRelease(void* p, size_t bytes);
+}
+
+
+/** \brief Standard conforming allocator returning memory aligned to Alignment
+           bytes.  This is the default for Array, 64 bytes being a cache line
+           and the width of an AVX-512 register.
+ **/
+
+template <typename T, size_t Alignment = 64>
+class AlignedAllocator {
+
+   public:
+      typedef T value_type;
+      template <typename U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+      AlignedAllocator() { }
+      template <typename U>
+      AlignedAllocator(AlignedAllocator<U, Alignment> const&) { }
+
+      T* allocate(size_t n)
+      {
+         return static_cast<T*>(Memory::alignedAllocate(n*sizeof(T), Alignment));
+      }
+
+      void deallocate(T* p, size_t) { Memory::alignedRelease(p); }
+
+      bool operator==(AlignedAllocator const&) const { return true; }
+      bool operator!=(AlignedAllocator const&) const { return false; }
+};
+
+
+/** \brief Allocator for large arrays that requests transparent or explicit
+           huge pages to reduce TLB pressure.  Falls back to aligned memory
+           where huge pages are unavailable.
+ **/
+
+template <typename T>
+class HugePageAllocator {
+
+   public:
+      typedef T value_type;
+      template <typename U> struct rebind { typedef HugePageAllocator<U> other; };
+
+      HugePageAllocator() { }
+      template <typename U>
+      HugePageAllocator(HugePageAllocator<U> const&) { }
+
+      T* allocate(size_t n)
+      {
+         return static_cast<T*>(Memory::hugePageAllocate(n*sizeof(T)));
+      }
+
+      void deallocate(T* p, size_t n) { Memory::hugePageRelease(p, n*sizeof(T)); }
+
+      bool operator==(HugePageAllocator const&) const { return true; }
+      bool operator!=(HugePageAllocator const&) const { return false; }
+};
+
+
+/** \brief Bump pointer memory pool.  Individual allocations are never
+           released, all memory is recovered at once by reset() or when the
+           Arena is destroyed, which must outlive any Array using it.
+
+    \usage Arena arena;
+           ArenaAllocator<double> alloc(arena);
+           Array<2, double, ArenaAllocator<double> > scratch(size, alloc);
+           ...
+           arena.reset();
+ **/
+
+class Arena {
+
+   public:
+      static size_t const DefaultBlockSize = 16 << 20;
+      static size_t const Alignment = 64;
+
+      Arena(size_t blockSize = DefaultBlockSize);
+      ~Arena();
+
+      void* allocate(size_t bytes);
+
+      /// Releases all allocations, retaining the first block for reuse.
+      void reset();
+
+      /// Number of bytes handed out since the last reset.
+      size_t used() const { return m_used; }
+
+      /// Process wide arena used by default constructed ArenaAllocators.
+      static Arena& global();
+
+   private:
+      Arena(Arena const&);
+      Arena& operator=(Arena const&);
+
+      struct Block {
+         char*  data;
+         size_t size;
+      };
+
+      size_t m_blockSize;
+      size_t m_offset;   // into the last block
+      size_t m_used;
+      std::vector<Block> m_blocks;
+      std::mutex m_mutex;
+};
+
+
+template <typename T>
+class ArenaAllocator {
+
+   public:
+      typedef T value_type;
+      template <typename U> struct rebind { typedef ArenaAllocator<U> other; };
+
+      ArenaAllocator() : m_arena(&Arena::global()) { }
+      ArenaAllocator(Arena& arena) : m_arena(&arena) { }
+      template <typename U>
+      ArenaAllocator(ArenaAllocator<U> const& that) : m_arena(&that.arena()) { }
+
+      T* allocate(size_t n) { return static_cast<T*>(m_arena->allocate(n*sizeof(T))); }
+      void deallocate(T*, size_t) { }
+
+      Arena& arena() const { return *m_arena; }
+
+      bool operator==(ArenaAllocator const& that) const { return m_arena == that.m_arena; }
+      bool operator!=(ArenaAllocator const& that) const { return m_arena != that.m_arena; }
+
+   private:
+      Arena* m_arena;
+};
+
+} // end namespace
+
+#endif
@@ -10,8 +10,17 @@
 ********************************************************************************/
 
 #include <array>
+#include <cstring>
+#include <memory>
 #include "hdf5.h"
 #include "H5Utils.h"
+#include "StoragePolicy.h"
+#include "Allocator.h"
+#include "Layout.h"
+#include "Structure.h"
+#include "Expression.h"
+#include "Transpose.h"
+#include "Logger.h"
 
 #include "Debug.h"
 
@@ -31,16 +40,37 @@ class ArrayBase {
        virtual size_t rank() const = 0;
        virtual ArrayBase* clone() const = 0;
 
+       /// Sets the on-disk layout for this array, overriding the default
+       /// policy of the ProjectFile.
+       void setStoragePolicy(StoragePolicy const& policy) { m_storagePolicy = policy; }
+       StoragePolicy const& storagePolicy() const { return m_storagePolicy; }
+
     protected:
        virtual hid_t h5DataType() const = 0;
        virtual void* buffer() = 0;
        virtual void const* buffer() const = 0;
-       virtual size_t const* dimensions() = 0;
+       virtual size_t const* dimensions() const = 0;
+
+       /// Order of the elements of buffer() with respect to dimensions().
+       virtual Layout::Id layout() const { return Layout::ColumnMajor; }
+
+       /// How buffer() maps to the elements of the array.  Arrays other than
+       /// Dense describe their stored (packed) data via dimensions().
+       virtual Structure::Id structure() const { return Structure::Dense; }
+
+       /// Returns a dataspace selecting the elements of buffer() in the
+       /// order they are written, or H5S_ALL if the buffer is contiguous.
+       /// Any other handle is closed by the caller.
+       virtual hid_t memorySpace() const { return H5S_ALL; }
+
+    private:
+       StoragePolicy m_storagePolicy;
 };
 
 
 /** \brief Simple arbitrary rank array class.  Underlying data is stored as a
-           single vector in column major format.
+           single vector, in column major format unless the RowMajor Order
+           policy is given (see Layout.h).
 
     \usage Use the Size typedef to give the size of each dimesion:
 
@@ -58,32 +88,109 @@ class ArrayBase {
            }
 
            array({3,4}) = 3.1415;
+
+           Arrays may be combined elementwise, see Expression.h:
+
+           array = 2.0*array + other;
+
+           The axes may be reordered with the blocked kernels of Transpose.h:
+
+           Array<2> transpose(array.permute({1, 0}));
         
     \param D the rank of the array
     \param T the type of data stored in the array
+    \param Alloc the allocator for the data buffer, see Allocator.h
+    \param Order the layout policy, ColumnMajor or RowMajor
  **/
 
-template < size_t D, typename T = double >
-class Array : public ArrayBase {
+template < size_t D, typename T = double, typename Alloc = AlignedAllocator<T>,
+   typename Order = ColumnMajor >
+class Array : public ArrayBase, public Expression<Array<D, T, Alloc, Order>, T> {
 
    public:
       typedef std::array<size_t, D> Size;
       typedef std::array<size_t, D> Index;
+      typedef Alloc Allocator;
+      typedef ExpressionTerminal<T> Node;
 
       static Size ZeroSize() { Size z; z.fill(0); return z; } 
 
-      Array(Size size = ZeroSize()) : m_length(0), m_data(0) { resize(size); }
+      Array(Size size = ZeroSize(), Alloc const& alloc = Alloc()) 
+       : m_data(0), m_length(0), m_alloc(alloc) { resize(size); }
+
+	  /// Creates a non-owning Array over existing data, for example a memory
+	  /// mapped region of a file.  The owner handle is held for the lifetime
+	  /// of the view and should keep the data valid.  Copying a view, or
+	  /// resizing it, creates an Array with its own data.
+      Array(Size size, T* data, std::shared_ptr<void> const& owner) 
+       : m_data(0), m_length(0)
+      {
+         setSize(size);
+         m_data  = data;
+         m_owner = owner;
+      }
 
-      Array(Array const& that) : m_length(0), m_data(0) { copy(that); }
+      Array(Array const& that) 
+       : ArrayBase(that), m_data(0), m_length(0), m_alloc(that.m_alloc) 
+      { 
+         copy(that); 
+      }
+
+	  /// Takes over the data of that, leaving it empty.
+      Array(Array&& that) 
+       : ArrayBase(that), m_data(0), m_length(0), m_alloc(that.m_alloc) 
+      { 
+         take(that); 
+      }
 
       ~Array() { destroy(); }
 
       Array& operator=(Array const& that) 
       {
-          if (this != &that) copy(that);
+          if (this != &that) {
+             ArrayBase::operator=(that);
+             copy(that);
+          }
+          return *this;
+      }
+
+      Array& operator=(Array&& that) 
+      {
+          if (this != &that) {
+             destroy();
+             ArrayBase::operator=(that);
+             m_alloc = that.m_alloc;
+             take(that);
+          }
           return *this;
       }
 
+      /// Evaluates the expression into the Array, which must have the same
+      /// length and layout as the operands.
+      template <typename E>
+      Array& operator=(Expression<E, T> const& e) { return assign<AssignOp>(e); }
+
+      template <typename E>
+      Array& operator+=(Expression<E, T> const& e) { return assign<AddOp>(e); }
+
+      template <typename E>
+      Array& operator-=(Expression<E, T> const& e) { return assign<SubOp>(e); }
+
+      template <typename E>
+      Array& operator*=(Expression<E, T> const& e) { return assign<MulOp>(e); }
+
+      template <typename E>
+      Array& operator/=(Expression<E, T> const& e) { return assign<DivOp>(e); }
+
+      Array& operator=(T const s)  { return assign<AssignOp>(ExpressionScalar<T>(s)); }
+      Array& operator+=(T const s) { return assign<AddOp>(ExpressionScalar<T>(s)); }
+      Array& operator-=(T const s) { return assign<SubOp>(ExpressionScalar<T>(s)); }
+      Array& operator*=(T const s) { return assign<MulOp>(ExpressionScalar<T>(s)); }
+      Array& operator/=(T const s) { return assign<DivOp>(ExpressionScalar<T>(s)); }
+
+      /// Leaf node used when the Array appears in an expression
+      Node node() const { return Node(m_data, m_length, Order::id); }
+
       Array* clone() const { return new Array(*this); }
 
 	  /// Resizes the Array to the given Size after deleting any exisiting
@@ -91,21 +198,21 @@ class Array : public ArrayBase {
 	  /// resize, if zero initialization is required, use the init() function.
       void resize(Size size) 
       { 
-         m_size = size;
-         size_t n(1);
-
-         for (size_t i = 0; i < m_size.size(); ++i) {
-             m_offsets[i] = n;
-             n *= m_size[i];
-         }
-
-         if (m_length != n) {
-            m_length = n;
-            if (m_data) delete [ ] m_data;
-            m_data = new T[n*sizeof(T)];
+         size_t n(m_length);
+         bool view(isView());
+         setSize(size);
+
+         if (m_length != n || view) {
+            if (m_data && !view) m_alloc.deallocate(m_data, n);
+            m_owner.reset();
+            m_data = 0;
+            m_data = m_alloc.allocate(m_length);
          }
       }
 
+      /// Returns true if the Array does not own its data.
+      bool isView() const { return m_owner.get() != 0; }
+
       /// Initializes the Array buffer to zero
       void init() { if (m_data) memset(m_data, 0, m_length*sizeof(T)); }
 
@@ -119,11 +226,50 @@ class Array : public ArrayBase {
 
       Size const& dims() const { return m_size; }
 
+      /// Distance, in elements, between successive indices of each dimension
+      Size const& strides() const { return m_offsets; }
+
+      Layout::Id layout() const { return Order::id; }
+
+      /// Returns a copy of the Array with its axes reordered, axis i of the
+      /// result is axis axes[i] of this Array.  The copy is made in cache
+      /// sized tiles and large Arrays may be split over several threads, 0
+      /// for one per core.  An empty Array is returned if axes is not a
+      /// permutation.
+      Array permute(Index const& axes, unsigned threads = 1) const
+      {
+         Array result(ZeroSize(), m_alloc);
+         if (!isPermutation(D, axes.data())) {
+            LOG_WARN("Invalid axis permutation for Array");
+            return result;
+         }
+
+         Size size;
+         for (size_t i = 0; i < D; ++i) size[i] = m_size[axes[i]];
+         result.ArrayBase::operator=(*this);
+         result.resize(size);
+
+         Size dims, perm;
+         storageOrder(axes, dims, perm);
+         libqch5::permute(m_data, result.m_data, D, dims.data(), perm.data(), threads);
+         return result;
+      }
+
+      /// Reorders the axes without a copy.  The extents must be unchanged by
+      /// the permutation, as for the transpose of a square matrix, otherwise
+      /// false is returned and the Array is left untouched.
+      bool permuteInPlace(Index const& axes, unsigned threads = 1)
+      {
+         Size dims, perm;
+         storageOrder(axes, dims, perm);
+         return libqch5::permuteInPlace(m_data, D, dims.data(), perm.data(), threads);
+      }
+
       // Allows faster direct access to the data buffer
       T& operator[](size_t i) { return m_data[i]; }
       T const& operator[](size_t i) const { return m_data[i]; }
 
-      // Column major index access
+      // Index access
       T& operator()(Index d) 
       {
          size_t offset(0);
@@ -157,28 +303,85 @@ class Array : public ArrayBase {
       void* buffer() { return m_data; }
       void const* buffer() const { return m_data; }
 
-      size_t*  dimensions() { return m_size.data(); }
+      size_t const* dimensions() const { return m_size.data(); }
 
       void copy(Array const& that) 
       {
          resize(that.dims());
-         memcpy(m_data, that.m_data, m_length*sizeof(T));
+         if (m_length) memcpy(m_data, that.m_data, m_length*sizeof(T));
       }
 
       void destroy()
       {
-         if (m_data) delete m_data;
+         if (m_data && !isView()) m_alloc.deallocate(m_data, m_length);
+         m_owner.reset();
          m_data   = 0;
          m_length = 0;
       }
 
    private:
+      template <typename Op, typename E>
+      Array& assign(Expression<E, T> const& expression)
+      {
+         typename E::Node const e(expression.self().node());
+         if (e.conforms(m_length, Order::id)) {
+            evaluate<Op>(m_data, m_length, e);
+         }else {
+            LOG_WARN("Non-conforming expression assigned to Array");
+         }
+         return *this;
+      }
+
+      /// Moves the data and shape from that, which must have been allocated
+      /// compatibly with m_alloc, and leaves that empty.
+      void take(Array& that)
+      {
+         m_data    = that.m_data;
+         m_length  = that.m_length;
+         m_size    = that.m_size;
+         m_offsets = that.m_offsets;
+         m_owner   = std::move(that.m_owner);
+
+         that.m_data = 0;
+         that.setSize(ZeroSize());
+         that.m_length = 0;
+      }
+
+      /// Expresses the axis permutation in terms of the column major
+      /// storage, where the axes of a RowMajor Array are reversed.
+      void storageOrder(Index const& axes, Size& dims, Size& perm) const
+      {
+         for (size_t i = 0; i < D; ++i) {
+             if (Order::id == Layout::RowMajor) {
+                dims[i] = m_size[D-1-i];
+                perm[i] = D-1-axes[D-1-i];
+             }else {
+                dims[i] = m_size[i];
+                perm[i] = axes[i];
+             }
+         }
+      }
+
+      /// Sets the dimensions and offsets without touching the data
+      void setSize(Size const& size)
+      {
+         m_size = size;
+         m_length = Order::strides(m_size, m_offsets);
+      }
+
       T*       m_data;
-      size_t   m_length;
+      size_t   m_length;  // also the allocated length of owned data
+      Alloc    m_alloc;
       Size     m_size;
       Size     m_offsets; // used for computing offset into m_data
+      std::shared_ptr<void> m_owner; // set for non-owning views
 };
 
+
+/// Row major Array with the default allocator
+template < size_t D, typename T = double >
+using RowMajorArray = Array<D, T, AlignedAllocator<T>, RowMajor>;
+
 } // end namespace
 
 #endif
@@ -0,0 +1,283 @@
+#ifndef LIBQCH5_ARRAYVIEW_H
+#define LIBQCH5_ARRAYVIEW_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include "Array.h"
+#include "Hyperslab.h"
+#include <algorithm>
+#include <vector>
+
+
+namespace libqch5 {
+
+/** \brief Non-owning, strided view of the data of an Array.  Slices, sub-blocks
+           and axis permutations of a view are themselves views and never copy
+           the underlying data, which must outlive the view.
+
+    \usage Array<3> density(size);
+           ArrayView<3> all(density);
+
+           // The 2D block at index 4 along the last axis
+           ArrayView<2> matrix(all.slice(2, 4));
+
+           // Rows 2-5 and every other column of that block
+           ArrayView<2> block(matrix.block(Hyperslab<2>({2, 0}, {4, 10}, {1, 2})));
+
+           // The transpose of the block
+           ArrayView<2> blockT(block.permute({1, 0}));
+
+           Views may be passed to RawData::createView() and are written via an
+           HDF5 memory selection, so only the viewed elements are written and
+           no intermediate copy is made.  Views that are not permuted map to
+           a hyperslab selection, permuted views to a (slower) element
+           selection.
+
+    \param D the rank of the view
+    \param T the type of data viewed
+ **/
+
+template < size_t D, typename T = double >
+class ArrayView : public ArrayBase {
+
+   public:
+      typedef std::array<size_t, D> Size;
+      typedef std::array<size_t, D> Index;
+
+      /// Views data with the given dimensions and per-dimension strides, in
+      /// elements.
+      ArrayView(T* data, Size const& dims, Size const& strides)
+       : m_data(data), m_dims(dims), m_strides(strides) { }
+
+      /// Views the whole of the array.
+      template <typename Alloc, typename Order>
+      ArrayView(Array<D, T, Alloc, Order>& array)
+       : m_data(array.length() ? &array[0] : 0), m_dims(array.dims()),
+         m_strides(array.strides()) { }
+
+      ArrayView* clone() const { return new ArrayView(*this); }
+
+      size_t rank() const { return D; }
+
+      size_t dim(size_t n) const { return (n < D ? m_dims[n] : 0); }
+
+      Size const& dims() const { return m_dims; }
+
+      Size const& strides() const { return m_strides; }
+
+      size_t length() const
+      {
+         size_t n(1);
+         for (size_t i = 0; i < D; ++i) n *= m_dims[i];
+         return n;
+      }
+
+      T& operator()(Index const& idx) const { return m_data[offset(idx)]; }
+
+      /// Returns true if the view covers a dense column major block, as for
+      /// an Array.
+      bool isContiguous() const
+      {
+         size_t stride(1);
+         for (size_t i = 0; i < D; ++i) {
+             if (m_dims[i] > 1 && m_strides[i] != stride) return false;
+             stride *= m_dims[i];
+         }
+         return true;
+      }
+
+      /// Returns the rank D-1 view with the given axis fixed at index.
+      ArrayView<D-1, T> slice(size_t axis, size_t index) const
+      {
+         static_assert(D > 1, "Only views of rank 2 or more can be sliced");
+         typename ArrayView<D-1, T>::Size dims, strides;
+         for (size_t i = 0, j = 0; i < D; ++i) {
+             if (i == axis) continue;
+             dims[j]    = m_dims[i];
+             strides[j] = m_strides[i];
+             ++j;
+         }
+         return ArrayView<D-1, T>(m_data + index*m_strides[axis], dims, strides);
+      }
+
+      /// Returns the sub-block selected by the Hyperslab, which is given
+      /// relative to this view.
+      ArrayView block(Hyperslab<D> const& slab) const
+      {
+         Size strides;
+         for (size_t i = 0; i < D; ++i) {
+             strides[i] = m_strides[i]*slab.stride[i];
+         }
+         return ArrayView(m_data + offset(slab.offset), slab.count, strides);
+      }
+
+      /// Returns a view with the axes reordered, axis i of the new view is
+      /// axis axes[i] of this one.
+      ArrayView permute(Index const& axes) const
+      {
+         Size dims, strides;
+         for (size_t i = 0; i < D; ++i) {
+             dims[i]    = m_dims[axes[i]];
+             strides[i] = m_strides[axes[i]];
+         }
+         return ArrayView(m_data, dims, strides);
+      }
+
+      /// Copies the viewed elements into array, which is resized to match.
+      /// Views that are an axis permutation of dense data, e.g. of a whole
+      /// Array, are copied with the blocked permute() from Transpose.h,
+      /// using the given number of threads.
+      template <typename Alloc, typename Order>
+      void copyTo(Array<D, T, Alloc, Order>& array, unsigned threads = 1) const
+      {
+         array.resize(m_dims);
+         size_t const n(length());
+         if (n == 0) return;
+
+         Index order;
+         if (Order::id == Layout::ColumnMajor && isPermutedBlock(order)) {
+            // Axis k of the dense data is axis order[k] of the view
+            Size dims, perm;
+            for (size_t k = 0; k < D; ++k) {
+                dims[k] = m_dims[order[k]];
+                perm[order[k]] = k;
+            }
+            libqch5::permute(m_data, &array[0], D, dims.data(), perm.data(), threads);
+            return;
+         }
+
+         Index idx;
+         idx.fill(0);
+
+         for (size_t k = 0; k < n; ++k) {
+             array(idx) = m_data[offset(idx)];
+             next(idx);
+         }
+      }
+
+
+   protected:
+      hid_t h5DataType() const { return H5DataType(T()); }
+
+      void* buffer() { return m_data; }
+      void const* buffer() const { return m_data; }
+
+      size_t const* dimensions() const { return m_dims.data(); }
+
+      /// Describes the viewed elements as a selection of the memory from
+      /// buffer().  Strides that nest, as they do for slices and blocks of
+      /// an Array, give a hyperslab of a row major memory space whose
+      /// extent for each axis is the ratio of successive strides.  Any
+      /// other view is described by an element selection in the order the
+      /// elements are written.
+      hid_t memorySpace() const
+      {
+         size_t const n(length());
+         if (n == 0 || isContiguous()) return H5S_ALL;
+
+         hsize_t extent[D], start[D], step[D], count[D];
+         bool nested(true);
+
+         for (size_t i = 0; i < D && nested; ++i) {
+             size_t const j(D-1-i);  // row major memory space index
+             start[j] = 0;
+             count[j] = m_dims[i];
+             step[j]  = 1;
+
+             if (m_strides[i] == 0) {
+                nested = false;
+             }else if (i == 0) {
+                step[j]   = m_strides[0];
+                extent[j] = (D > 1) ? m_strides[1] : m_strides[0]*(m_dims[0]-1) + 1;
+                nested    = m_strides[0]*(m_dims[0]-1) < extent[j];
+             }else if (i < D-1) {
+                nested    = m_strides[i+1] % m_strides[i] == 0;
+                extent[j] = m_strides[i+1] / m_strides[i];
+                nested    = nested && m_dims[i] <= extent[j];
+             }else {
+                extent[j] = m_dims[i];
+             }
+         }
+
+         if (nested) {
+            hid_t sid(H5Screate_simple(D, extent, 0));
+            if (sid >= 0 &&
+                H5Sselect_hyperslab(sid, H5S_SELECT_SET, start, step, count, 0) < 0) {
+               H5Sclose(sid);
+               sid = -1;
+            }
+            return sid;
+         }
+
+         std::vector<hsize_t> points(n);
+         hsize_t last(0);
+         Index idx;
+         idx.fill(0);
+
+         for (size_t k = 0; k < n; ++k) {
+             points[k] = offset(idx);
+             if (points[k] > last) last = points[k];
+             next(idx);
+         }
+
+         hsize_t extent1(last+1);
+         hid_t sid(H5Screate_simple(1, &extent1, 0));
+         if (sid >= 0 &&
+             H5Sselect_elements(sid, H5S_SELECT_SET, n, points.data()) < 0) {
+            H5Sclose(sid);
+            sid = -1;
+         }
+         return sid;
+      }
+
+
+   private:
+      /// Returns true if the axes of the view, taken in the order returned,
+      /// cover a dense column major block.
+      bool isPermutedBlock(Index& order) const
+      {
+         for (size_t i = 0; i < D; ++i) order[i] = i;
+         std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            bool const unitA(m_dims[a] == 1), unitB(m_dims[b] == 1);
+            return unitA != unitB ? unitB : m_strides[a] < m_strides[b];
+         });
+
+         size_t stride(1);
+         for (size_t k = 0; k < D; ++k) {
+             size_t const axis(order[k]);
+             if (m_dims[axis] > 1 && m_strides[axis] != stride) return false;
+             stride *= m_dims[axis];
+         }
+         return true;
+      }
+
+      size_t offset(Index const& idx) const
+      {
+         size_t k(0);
+         for (size_t i = 0; i < D; ++i) k += idx[i]*m_strides[i];
+         return k;
+      }
+
+      /// Advances the column major index idx.
+      void next(Index& idx) const
+      {
+         for (size_t i = 0; i < D; ++i) {
+             if (++idx[i] < m_dims[i]) return;
+             idx[i] = 0;
+         }
+      }
+
+      T*   m_data;
+      Size m_dims;
+      Size m_strides;
+};
+
+} // end namespace
+
+#endif
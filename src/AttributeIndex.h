@@ -0,0 +1,185 @@
+#ifndef LIBQCH5_ATTRIBUTEINDEX_H
+#define LIBQCH5_ATTRIBUTEINDEX_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include "hdf5.h"
+#include "Attributes.h"
+#include "Types.h"
+#include <cmath>
+#include <unordered_map>
+
+
+namespace libqch5 {
+
+/** \brief A conjunction of predicates on indexed attributes, answered by
+           ProjectFile::find().
+
+    \usage IndexQuery query;
+           query.equals("theory", "b3lyp").below("energy", -76.0);
+
+           List<String> paths;
+           project.find(query, paths);
+
+           Numeric attributes (int, unsigned and double) are compared as
+           doubles.  Ranges are inclusive.
+ **/
+
+class IndexQuery {
+
+   public:
+      struct Predicate {
+         String key;
+         bool   numeric;
+         double lower, upper;
+         String text;
+      };
+
+      IndexQuery& equals(String const& key, String const& value)
+      {
+         Predicate p = { key, false, 0.0, 0.0, value };
+         m_predicates.push_back(p);
+         return *this;
+      }
+
+      IndexQuery& equals(String const& key, char const* value)
+      {
+         return equals(key, String(value));
+      }
+
+      IndexQuery& equals(String const& key, double value)
+      {
+         return range(key, value, value);
+      }
+
+      IndexQuery& range(String const& key, double lower, double upper)
+      {
+         Predicate p = { key, true, lower, upper, String() };
+         m_predicates.push_back(p);
+         return *this;
+      }
+
+      IndexQuery& below(String const& key, double upper)
+      {
+         return range(key, -HUGE_VAL, std::nextafter(upper, -HUGE_VAL));
+      }
+
+      IndexQuery& above(String const& key, double lower)
+      {
+         return range(key, std::nextafter(lower, HUGE_VAL), HUGE_VAL);
+      }
+
+      List<Predicate> const& predicates() const { return m_predicates; }
+
+   private:
+      List<Predicate> m_predicates;
+};
+
+
+/** \brief Index of the values of selected attributes over the objects of a
+           ProjectFile, so queries need not open every group.
+
+    \usage The index is kept in memory and is updated as objects are written.
+           It is saved by ProjectFile::flush() and on closing, as sorted
+           tables under the reserved group GroupName:
+
+              /_Index/Paths            object paths, by id
+              /_Index/<key>/Numbers    sorted values and the id of the
+              /_Index/<key>/NumberIds  object holding each
+              /_Index/<key>/Strings
+              /_Index/<key>/StringIds
+
+           Only the indexed keys are recorded.  Vector attributes and NaN
+           values are not indexed.  Each save rewrites the tables.
+
+           The file size at the time of saving is recorded, and reset by
+           invalidate() before the file is next changed.  An index read
+           from a file of a different size, for example after a crash or a
+           write by a library without index support, is out of date.  Only
+           its keys are kept and queries fail until it is rebuilt.
+ **/
+
+class AttributeIndex {
+
+   public:
+      static char const* GroupName;
+
+      AttributeIndex() : m_dirty(false), m_stale(false), m_current(false) { }
+
+      /// Sets the attribute keys to be indexed.  Values of keys no longer
+      /// indexed are dropped; new keys are empty until the objects holding
+      /// them are written or the index is rebuilt.
+      /// The key "Paths" is reserved.
+      void setKeys(List<String> const& keys);
+      List<String> keys() const;
+
+      bool isEnabled() const { return !m_columns.empty(); }
+      bool isDirty() const { return m_dirty; }
+      bool isStale() const { return m_stale; }
+
+      /// Records the indexed attributes of the object at path, replacing
+      /// any earlier values.
+      void update(String const& path, Attributes const& attributes);
+
+      /// Sets paths to the objects satisfying all the predicates of query,
+      /// in the order they were first indexed.  Returns false if a key is
+      /// not indexed or the index is out of date.
+      bool find(IndexQuery const& query, List<String>& paths) const;
+
+      /// Loads the index from the file fid, which need not hold one.
+      bool read(hid_t fid);
+
+      /// Replaces the index held in the file fid, unless it is out of date
+      bool write(hid_t fid);
+
+      /// Marks the index held in the file fid as out of date, if it was
+      /// current.  Must be called before the first change to the file after
+      /// reading or writing the index.
+      void invalidate(hid_t fid);
+
+      /// Drops the keys and values, the index is no longer out of date.
+      void clear();
+
+   private:
+      static char const* PathsName;
+      static char const* FileSizeName;
+
+      typedef std::pair<double, size_t> NumberRow;
+      typedef std::pair<String, size_t> StringRow;
+
+      /// Values of one key.  The rows, sorted by value then id, are formed
+      /// from the maps when first needed after an update.
+      struct Column {
+         Column() : sorted(true) { }
+         std::unordered_map<size_t, double> numbers;
+         std::unordered_map<size_t, String> strings;
+         mutable std::vector<NumberRow> numberRows;
+         mutable std::vector<StringRow> stringRows;
+         mutable bool sorted;
+         void sort() const;
+      };
+
+      /// Returns the id of path, adding it if need be.
+      size_t id(String const& path);
+
+      /// Sets ids to the sorted ids matching the predicate
+      static void match(Column const&, IndexQuery::Predicate const&,
+         std::vector<size_t>& ids);
+
+      std::vector<String> m_paths;
+      std::unordered_map<String, size_t> m_ids;
+      std::map<String, Column> m_columns;
+      bool m_dirty;
+      bool m_stale;     // read from a file changed since it was saved
+      bool m_current;   // the copy in the file is marked as up to date
+};
+
+} // end namespace
+
+#endif
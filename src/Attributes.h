@@ -11,87 +11,231 @@
 
 #include "hdf5.h"
 #include "Types.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
 
 
 namespace libqch5 {
 
-/// A wrapper around Attribute maps of various types.  Also takes care of writing
-/// attributes to file.
+/** \brief Typed scalar and small vector attributes of an object.  Also takes care of writing
+           attributes to file, either as one HDF5 attribute per key or, if
+           packed, as members of a single compound attribute named
+           PackedName.  Either form is recognised when reading.
+
+    \usage The attributes are held in a single vector sorted by key, so
+           objects with many attributes need only one allocation for the
+           entries and one for the string and vector values.  Keys are
+           interned, and the entries are plain data, so copying is little
+           more than two memcpys.  Lookup is a binary search that accepts
+           either a String or a char const* key without constructing a
+           temporary:
+
+           attributes.set("basis", String("6-31G*"));
+           attributes.set("charge", 0);
+
+           int charge;
+           if (attributes.get("charge", charge)) { ... }
+
+           double dipole[] = { 0.0, 0.0, 1.85 };
+           attributes.set("dipole", dipole, 3);
+           std::vector<double> energies;
+           attributes.get("energies", energies);
+
+           Vectors are written as a single rank 1 HDF5 attribute, which
+           avoids the cost of a dataset for small arrays.  A vector of
+           length one is read back as a scalar, which get() also returns as
+           a vector.
+
+           Each key holds a single value; setting a value of another type
+           replaces it, and get() returns false if the type does not match.
+           PackedName is reserved and cannot be used as a key.  Writing in
+           one form removes the attributes of the other, so stale values are
+           not merged on reading.
+ **/
+
 class Attributes {
 
    public:
-      void set(String const& key, int value) {
-         m_attributesInt[key] =  value;
-      }
+      static char const* PackedName;
+
+      enum Type { Int, UInt, Double, Text, IntVector, UIntVector, DoubleVector };
+
+      /// Key argument that accepts either string type
+      struct Key {
+         Key(char const* s) : data(s), size(strlen(s)) { }
+         Key(String const& s) : data(s.c_str()), size(s.size()) { }
+         char const* data;
+         size_t      size;
+      };
+
+      Attributes() : m_packed(false), m_garbage(0) { }
+
+      /// Objects with many attributes are written faster when packed, at
+      /// the cost of the attributes not being visible individually to other
+      /// HDF5 tools.
+      void setPacked(bool packed) { m_packed = packed; }
+      bool packed() const { return m_packed; }
+
+      void set(Key const key, int value)      { Value v(Int);    v.i = value;  insert(key, v); }
+      void set(Key const key, unsigned value) { Value v(UInt);   v.u = value;  insert(key, v); }
+      void set(Key const key, double value)   { Value v(Double); v.d = value;  insert(key, v); }
+      void set(Key const key, String const& value);
 
-      void set(String const& key, unsigned value) {
-         m_attributesUInt[key] =  value;
+      void set(Key const key, int const* values, size_t n)      { setVector(key, IntVector, values, n); }
+      void set(Key const key, unsigned const* values, size_t n) { setVector(key, UIntVector, values, n); }
+      void set(Key const key, double const* values, size_t n)   { setVector(key, DoubleVector, values, n); }
+
+      template <typename T>
+      void set(Key const key, std::vector<T> const& values) { set(key, values.data(), values.size()); }
+
+      /// If found, sets value to the value of the attribute 
+      /// and returns true, otherwise, returns false.
+      bool get(Key const key, int& value) const
+      {
+         Value const* v(find(key, Int));
+         if (v) value = v->i;
+         return v;
       }
 
-      void set(String const& key, double value) {
-         m_attributesDouble[key] =  value;
+      bool get(Key const key, unsigned& value) const
+      {
+         Value const* v(find(key, UInt));
+         if (v) value = v->u;
+         return v;
       }
 
-      void set(String const& key, String const& value) {
-         m_attributesString[key] =  value;
+      bool get(Key const key, double& value) const
+      {
+         Value const* v(find(key, Double));
+         if (v) value = v->d;
+         return v;
       }
 
-      /// If found, sets value to the value of the attribute 
-      /// and returns true, otherwise, returns false.
-      bool get(String const& key, int& value) const {
-         StringMap<int>::const_iterator iter(m_attributesInt.find(key));
-         if (iter != m_attributesInt.end()) {
-            value = iter->second;
-            return true;
-         } 
-         return false;
+      bool get(Key const key, String& value) const
+      {
+         Value const* v(find(key, Text));
+         if (v) value.assign(data(*v), v->s.length);
+         return v;
       }
 
-      /// If found, sets value to the value of the attribute 
-      /// and returns true, otherwise, returns false.
-      bool get(String const& key, unsigned& value) const {
-         StringMap<unsigned>::const_iterator iter(m_attributesUInt.find(key));
-         if (iter != m_attributesUInt.end()) {
-            value = iter->second;
-            return true;
-         } 
-         return false;
+      /// Gets an int, unsigned or double attribute as a double
+      bool getNumber(Key const key, double& value) const;
+
+      bool get(Key const key, std::vector<int>& values) const
+      {
+         return getVector(key, IntVector, Int, values);
       }
 
-      /// If found, sets value to the value of the attribute 
-      /// and returns true, otherwise, returns false.
-      bool get(String const& key, double& value) const {
-         StringMap<double>::const_iterator iter(m_attributesDouble.find(key));
-         if (iter != m_attributesDouble.end()) {
-            value = iter->second;
-            return true;
-         } 
-         return false;
+      bool get(Key const key, std::vector<unsigned>& values) const
+      {
+         return getVector(key, UIntVector, UInt, values);
       }
 
-      /// If found, sets value to the value of the attribute 
-      /// and returns true, otherwise, returns false.
-      bool get(String const& key, String& value) const {
-         StringMap<String>::const_iterator iter(m_attributesString.find(key));
-         if (iter != m_attributesString.end()) {
-            value = iter->second;
-            return true;
-         } 
-         return false;
+      bool get(Key const key, std::vector<double>& values) const
+      {
+         return getVector(key, DoubleVector, Double, values);
       }
 
+      size_t size() const { return m_entries.size(); }
+
       // Sets the attributes to the given object ID 
       bool write(hid_t oid, char const* label) const;
       bool read(hid_t oid, char const* label);
 
+      /// Writes the attributes to the open object oid
+      bool write(hid_t oid) const;
+
+      /// Writes a single attribute to the open object oid, replacing any
+      /// existing attribute of the same name.
+      static bool write(hid_t oid, char const* key, unsigned value);
+
       void clear();
       void dump() const;
 
    protected:
-      StringMap<int>      m_attributesInt;
-      StringMap<unsigned> m_attributesUInt;
-      StringMap<double>   m_attributesDouble;
-      StringMap<String>   m_attributesString;
+      /// Offset in bytes and length in elements of a string or vector value
+      /// in m_data
+      struct Span {
+         uint32_t offset;
+         uint32_t length;
+      };
+
+      struct Value {
+         explicit Value(Type t = Int) : type(t) { s.offset = s.length = 0; }
+         Type type;
+         union {
+            int      i;
+            unsigned u;
+            double   d;
+            Span     s;
+         };
+      };
+
+      struct Entry {
+         char const* key;   // interned
+         Value       value;
+      };
+
+      /// Returns the value of key, or null if there is none
+      Value const* find(Key const key) const;
+
+      /// Returns the value of key if it has the given type, otherwise null
+      Value const* find(Key const key, Type const type) const;
+
+      /// Adds or replaces the value of key, returning false if the key is
+      /// reserved
+      bool insert(Key const key, Value const& value);
+
+      /// Returns true, with a warning, if key is PackedName, which cannot
+      /// be distinguished from the packed attributes in the file.
+      static bool isReserved(Key const key);
+
+      char const* data(Value const& value) const { return m_data.data() + value.s.offset; }
+
+      /// Size in bytes of the elements of the given type
+      static size_t elementSize(Type const type);
+
+      /// Copies n elements of the given type to m_data, returning the span
+      Span append(Type const type, void const* values, size_t n);
+
+      void setVector(Key const key, Type const type, void const* values, size_t n);
+
+      /// Also accepts a scalar of the corresponding type
+      template <typename T>
+      bool getVector(Key const key, Type const type, Type const scalar, 
+         std::vector<T>& values) const
+      {
+         Value const* v(find(key, type));
+         if (v) {
+            values.resize(v->s.length);
+            if (!values.empty()) memcpy(values.data(), data(*v), values.size()*sizeof(T));
+         }else if ((v = find(key, scalar))) {
+            T x;
+            scalarValue(*v, x);
+            values.assign(1, x);
+         }
+         return v;
+      }
+
+      static void scalarValue(Value const& v, int& x)      { x = v.i; }
+      static void scalarValue(Value const& v, unsigned& x) { x = v.u; }
+      static void scalarValue(Value const& v, double& x)   { x = v.d; }
+
+      bool writeSeparate(hid_t oid) const;
+      bool writeVector(hid_t oid, char const* key, Value const&) const;
+      bool writePacked(hid_t oid) const;
+      bool readPacked(hid_t aid, hid_t tid, std::vector<char>& buffer);
+
+      /// Callback for H5Aiterate2
+      struct ReadState;
+      static herr_t readAttribute(hid_t oid, char const* name, H5A_info_t const*,
+         void* state);
+
+      bool               m_packed;
+      std::vector<Entry> m_entries;   // sorted by key
+      std::vector<char>  m_data;      // string and vector values
+      size_t             m_garbage;   // unreferenced bytes of m_data
 };
 
 } // end namespace
@@ -0,0 +1,349 @@
+#ifndef LIBQCH5_BLOCKSPARSE_H
+#define LIBQCH5_BLOCKSPARSE_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include <cmath>
+#include <complex>
+#include <vector>
+#include "Array.h"
+
+
+namespace libqch5 {
+
+/// Non-template base for BlockSparseArray that manages the block index and
+/// gives RawData access to the blocks without knowing the rank or type.
+class BlockSparseBase : public ArrayBase {
+
+   friend class RawData;
+
+   public:
+      static size_t const npos = size_t(-1);
+
+      size_t rank() const { return m_dims.size(); }
+
+      /// Number of blocks stored
+      size_t blockCount() const { return m_keys.size(); }
+
+      /// Number of elements stored, over all blocks
+      size_t valueCount() const { return m_valueCount; }
+
+      /// Removes all blocks
+      void clear();
+
+      /// Sets the dimensions and block size, removing all blocks
+      void reshape(size_t const* dims, size_t const* blockSize);
+
+      Structure::Id structure() const { return Structure::BlockSparse; }
+
+   protected:
+      BlockSparseBase(size_t rank, size_t const* dims, size_t const* blockSize);
+
+      size_t const* dimensions() const { return m_dims.data(); }
+
+      /// Returns the key of the block at the given grid coordinates, or npos
+      /// if they are out of range.  Keys are the column major offset of the
+      /// block in the grid, so blocks are held in storage order.
+      size_t key(size_t const* coords) const;
+      void coords(size_t key, size_t* coords) const;
+
+      /// Extents of the block with the given key.  Blocks at the upper edge
+      /// of the array are truncated to fit.
+      void blockDims(size_t key, size_t* dims) const;
+      size_t blockLength(size_t key) const;
+
+      /// Returns the position of the block in m_keys, or npos if absent.
+      size_t slot(size_t key) const;
+
+      /// Returns the position of the block, adding it with zeroed values if
+      /// it is not already present.
+      size_t insert(size_t key);
+
+      /// Replaces the index with n blocks at the given (row major, n by
+      /// rank) grid coordinates, as read from file.  The blocks must be in
+      /// storage order.  The values are left for the caller to fill.
+      bool setBlocks(size_t n, hsize_t const* coords);
+
+      virtual void resizeValues(size_t n) = 0;
+
+      std::vector<size_t> m_dims;
+      std::vector<size_t> m_blockSize;
+      std::vector<size_t> m_grid;     // number of blocks along each axis
+      std::vector<size_t> m_keys;     // sorted
+      std::vector<size_t> m_offsets;  // into the values, for each key
+      size_t m_valueCount;
+
+   private:
+      /// Sets the dimensions and block size without touching the blocks
+      void setShape(size_t const* dims, size_t const* blockSize);
+};
+
+
+/** \brief Array of rank D of which only selected dense blocks are stored,
+           for example screened integrals or localized orbital coefficients.
+
+    \usage The array is divided into a grid of blocks of blockSize elements
+           (truncated at the upper edges).  Each stored block is a dense
+           column major array; absent blocks are zero.
+
+           BlockSparseArray<2>::Size dims = {{ nBasis, nOcc }}, tile = {{ 32, 8 }};
+           BlockSparseArray<2>& c(data.createBlockSparseArray<2,double>(dims, tile));
+
+           BlockSparseArray<2>::Index b = {{ 3, 0 }};
+           double* block(c.insert(b));        // zeroed, c.blockDims(b) in size
+           double const* same(c.find(b));     // null if the block is absent
+
+           for (auto block : c) {
+               // block.index, block.dims and block.data
+           }
+
+           RawData writes the array as a group holding an Index dataset of
+           the block coordinates and a Values dataset of the concatenated
+           blocks, and it is read back as a BlockSparseArray without forming
+           the dense array.  Pointers to block data are invalidated when
+           blocks are inserted.
+
+    \param D the rank of the array
+    \param T the type of data stored in the array
+ **/
+
+template < size_t D, typename T = double >
+class BlockSparseArray : public BlockSparseBase {
+
+   public:
+      typedef std::array<size_t, D> Size;
+      typedef std::array<size_t, D> Index;
+
+      /// A stored block: its coordinates in the block grid, its extents
+      /// and its data
+      template <typename P>
+      struct BlockRef {
+         Index index;
+         Size  dims;
+         P*    data;
+      };
+
+      typedef BlockRef<T> Block;
+      typedef BlockRef<T const> ConstBlock;
+
+      /// Iterates over the stored blocks in storage order
+      template <typename A, typename P>
+      class BlockIterator {
+         public:
+            BlockIterator(A* array, size_t slot) : m_array(array), m_slot(slot) { }
+            BlockRef<P> operator*() const { return m_array->at(m_slot); }
+            BlockIterator& operator++() { ++m_slot; return *this; }
+            bool operator==(BlockIterator const& that) const { return m_slot == that.m_slot; }
+            bool operator!=(BlockIterator const& that) const { return m_slot != that.m_slot; }
+         private:
+            A*     m_array;
+            size_t m_slot;
+      };
+
+      typedef BlockIterator<BlockSparseArray, T> iterator;
+      typedef BlockIterator<BlockSparseArray const, T const> const_iterator;
+
+      static Size ZeroSize() { Size z; z.fill(0); return z; }
+      static Size UnitSize() { Size z; z.fill(1); return z; }
+
+      BlockSparseArray(Size const& dims = ZeroSize(), Size const& blockSize = UnitSize())
+       : BlockSparseBase(D, dims.data(), blockSize.data()) { }
+
+      BlockSparseArray* clone() const { return new BlockSparseArray(*this); }
+
+      Size dims() const { return toSize(m_dims); }
+      Size blockSize() const { return toSize(m_blockSize); }
+
+      /// Number of blocks along each axis
+      Size gridSize() const { return toSize(m_grid); }
+
+      /// Extents of the block at the given grid coordinates
+      Size blockDims(Index const& index) const
+      {
+         Size dims(ZeroSize());
+         size_t const k(key(index.data()));
+         if (k != npos) BlockSparseBase::blockDims(k, dims.data());
+         return dims;
+      }
+
+      /// Returns the data of the block at the given grid coordinates, or
+      /// null if it is not stored.
+      T* find(Index const& index)
+      {
+         size_t const s(slot(key(index.data())));
+         return s == npos ? 0 : &m_values[m_offsets[s]];
+      }
+
+      T const* find(Index const& index) const
+      {
+         size_t const s(slot(key(index.data())));
+         return s == npos ? 0 : &m_values[m_offsets[s]];
+      }
+
+      /// Returns the data of the block at the given grid coordinates, which
+      /// is added, zeroed, if not already stored.  Null is returned if the
+      /// coordinates are out of range.
+      T* insert(Index const& index)
+      {
+         size_t const k(key(index.data()));
+         if (k == npos) return 0;
+         size_t const s(BlockSparseBase::insert(k));
+         return m_values.empty() ? 0 : &m_values[m_offsets[s]];
+      }
+
+      /// Returns the element at idx, which is zero if its block is absent.
+      T operator()(Index const& idx) const
+      {
+         Index index;
+         for (size_t i = 0; i < D; ++i) index[i] = idx[i] / m_blockSize[i];
+         T const* block(find(index));
+         if (!block) return T(0);
+
+         Size const dims(blockDims(index));
+         size_t offset(0), stride(1);
+         for (size_t i = 0; i < D; ++i) {
+             offset += (idx[i] - index[i]*m_blockSize[i])*stride;
+             stride *= dims[i];
+         }
+         return block[offset];
+      }
+
+      Block at(size_t slot) { return blockAt<T>(this, slot); }
+      ConstBlock at(size_t slot) const { return blockAt<T const>(this, slot); }
+
+      iterator begin() { return iterator(this, 0); }
+      iterator end() { return iterator(this, blockCount()); }
+      const_iterator begin() const { return const_iterator(this, 0); }
+      const_iterator end() const { return const_iterator(this, blockCount()); }
+
+      /// Stores the blocks of dense that have an element of magnitude
+      /// greater than threshold, replacing the current contents.
+      template <typename A, typename O>
+      void fromDense(Array<D, T, A, O> const& dense, T threshold = T(0))
+      {
+         reshape(dense.dims().data(), m_blockSize.data());
+         if (dense.length() == 0) return;
+
+         T const* data(&dense[0]);
+         Size const& strides(dense.strides());
+         Index index;
+         index.fill(0);
+         size_t const n(gridLength(m_grid));
+         auto const cutoff(std::abs(threshold));
+
+         for (size_t b = 0; b < n; ++b) {
+             Size const dims(blockDims(index));
+             bool const keep(visit(data, strides, index, dims, [cutoff](T const& x) {
+                return std::abs(x) > cutoff;
+             }));
+
+             if (keep) {
+                T* block(insert(index));
+                visit(data, strides, index, dims, [&block](T const& x) {
+                   *block++ = x;
+                   return false;
+                });
+             }
+             next(index, m_grid);
+         }
+      }
+
+      /// Expands into the dense array, with zeros for the absent blocks.
+      template <typename A, typename O>
+      void toDense(Array<D, T, A, O>& dense) const
+      {
+         dense.resize(dims());
+         dense.init();
+         if (dense.length() == 0) return;
+
+         T* data(&dense[0]);
+         for (ConstBlock block : *this) {
+             T const* value(block.data);
+             visit(data, dense.strides(), block.index, block.dims, [&value](T& y) {
+                y = *value++;
+                return false;
+             });
+         }
+      }
+
+
+   protected:
+      hid_t h5DataType() const { return H5DataType(T()); }
+
+      void* buffer() { return m_values.data(); }
+      void const* buffer() const { return m_values.data(); }
+
+      void resizeValues(size_t n) { m_values.resize(n); }
+
+   private:
+      static Size toSize(std::vector<size_t> const& v)
+      {
+         Size s;
+         std::copy(v.begin(), v.end(), s.begin());
+         return s;
+      }
+
+      static size_t gridLength(std::vector<size_t> const& grid)
+      {
+         size_t n(1);
+         for (size_t i = 0; i < D; ++i) n *= grid[i];
+         return n;
+      }
+
+      /// Advances the column major index idx within dims
+      template <typename S>
+      static void next(Index& idx, S const& dims)
+      {
+         for (size_t i = 0; i < D; ++i) {
+             if (++idx[i] < dims[i]) return;
+             idx[i] = 0;
+         }
+      }
+
+      /// Calls f on the elements of the block at index of the array data,
+      /// with the given strides, in column major block order.  Stops early,
+      /// returning true, if f returns true.
+      template <typename P, typename F>
+      bool visit(P* data, Size const& strides, Index const& index, Size const& dims,
+         F f) const
+      {
+         size_t base(0), n(1);
+         for (size_t i = 0; i < D; ++i) {
+             base += index[i]*m_blockSize[i]*strides[i];
+             n *= dims[i];
+         }
+
+         Index idx;
+         idx.fill(0);
+         for (size_t k = 0; k < n; ++k) {
+             size_t offset(base);
+             for (size_t i = 0; i < D; ++i) offset += idx[i]*strides[i];
+             if (f(data[offset])) return true;
+             next(idx, dims);
+         }
+         return false;
+      }
+
+      template <typename P, typename A>
+      static BlockRef<P> blockAt(A* array, size_t slot)
+      {
+         BlockRef<P> block;
+         size_t const k(array->m_keys[slot]);
+         array->coords(k, block.index.data());
+         array->BlockSparseBase::blockDims(k, block.dims.data());
+         block.data = array->m_values.empty() ? 0 : &array->m_values[array->m_offsets[slot]];
+         return block;
+      }
+
+      std::vector<T, AlignedAllocator<T> > m_values;
+};
+
+} // end namespace
+
+#endif
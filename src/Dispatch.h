@@ -0,0 +1,139 @@
+#ifndef LIBQCH5_DISPATCH_H
+#define LIBQCH5_DISPATCH_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include "H5Utils.h"
+#include <array>
+#include <cstddef>
+
+
+namespace libqch5 {
+
+class ArrayBase;
+
+/// Highest rank of the arrays that can be read from file
+size_t const MaxRank = 8;
+
+/// List of element types
+template <typename... Ts>
+struct ElementTypes { };
+
+/// The element types arrays can be read back as
+typedef ElementTypes<double, float, std::complex<double>, int, int64_t, uint8_t>
+   StoredTypes;
+
+
+/** \brief Maps a run-time element type and rank onto the instantiation
+           Factory<D,T> that creates the corresponding array.
+
+    \usage Factory<D,T> provides a static create() returning an ArrayBase*:
+
+           template <size_t D, typename T>
+           struct NewArray {
+              static ArrayBase* create(size_t const* dims) { ... }
+           };
+
+           ArrayBase* array(Dispatch<NewArray>::create(type, rank, dims));
+
+           Null is returned if the type is not one of StoredTypes or the rank
+           is outside 1 ... MaxRank.  All the instantiations are generated at
+           compile time, so adding a type to StoredTypes makes it readable at
+           every rank.
+ **/
+
+template <template <size_t, typename> class Factory, typename Types = StoredTypes>
+struct Dispatch;
+
+
+/// Selects the rank for a given element type
+template <template <size_t, typename> class Factory, typename T, size_t D = 1>
+struct RankDispatch {
+   template <typename... Args>
+   static ArrayBase* create(size_t rank, Args const&... args)
+   {
+      if (rank == D) return Factory<D, T>::create(args...);
+      return RankDispatch<Factory, T, D+1>::create(rank, args...);
+   }
+};
+
+template <template <size_t, typename> class Factory, typename T>
+struct RankDispatch<Factory, T, MaxRank+1> {
+   template <typename... Args>
+   static ArrayBase* create(size_t, Args const&...) { return 0; }
+};
+
+
+template <template <size_t, typename> class Factory, typename T, typename... Ts>
+struct Dispatch<Factory, ElementTypes<T, Ts...> > {
+   template <typename... Args>
+   static ArrayBase* create(hid_t type, size_t rank, Args const&... args)
+   {
+      if (H5Tequal(type, H5DataType(T())) > 0) {
+         return RankDispatch<Factory, T>::create(rank, args...);
+      }
+      return Dispatch<Factory, ElementTypes<Ts...> >::create(type, rank, args...);
+   }
+};
+
+template <template <size_t, typename> class Factory>
+struct Dispatch<Factory, ElementTypes<> > {
+   template <typename... Args>
+   static ArrayBase* create(hid_t, size_t, Args const&...) { return 0; }
+};
+
+
+/// Finds the element type matching the HDF5 type tid, returning its native
+/// type, or -1 if there is none.
+template <typename Types = StoredTypes>
+struct NativeType;
+
+template <typename T, typename... Ts>
+struct NativeType<ElementTypes<T, Ts...> > {
+   static hid_t find(hid_t tid)
+   {
+      if (H5Tequal(tid, H5DataType(T())) > 0) return H5DataType(T());
+      return NativeType<ElementTypes<Ts...> >::find(tid);
+   }
+
+   /// As above for the name given by H5TypeName()
+   static hid_t find(String const& name)
+   {
+      if (name == H5TypeName(T())) return H5DataType(T());
+      return NativeType<ElementTypes<Ts...> >::find(name);
+   }
+
+   /// Returns the H5TypeName() of the native type, or null
+   static char const* name(hid_t type)
+   {
+      if (H5Tequal(type, H5DataType(T())) > 0) return H5TypeName(T());
+      return NativeType<ElementTypes<Ts...> >::name(type);
+   }
+};
+
+template <>
+struct NativeType<ElementTypes<> > {
+   static hid_t find(hid_t) { return -1; }
+   static hid_t find(String const&) { return -1; }
+   static char const* name(hid_t) { return 0; }
+};
+
+
+/// Returns the first D entries of dims as a Size for Array<D>
+template <size_t D>
+std::array<size_t, D> toSize(size_t const* dims)
+{
+   std::array<size_t, D> size;
+   for (size_t i = 0; i < D; ++i) size[i] = dims[i];
+   return size;
+}
+
+} // end namespace
+
+#endif
@@ -0,0 +1,322 @@
+#ifndef LIBQCH5_EXPRESSION_H
+#define LIBQCH5_EXPRESSION_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include "Layout.h"
+#include "Logger.h"
+#include "Simd.h"
+#include <cmath>
+
+
+namespace libqch5 {
+
+/** \brief Expression templates for elementwise arithmetic on Arrays.
+
+    \usage Arithmetic on Arrays builds an expression that is only evaluated on
+           assignment, in a single pass and without temporaries:
+
+           Array<2> density(size), fock(size), h(size);
+           fock = h + 2.0*density;
+           fock *= 0.5;
+           double e(dot(density, h + fock));
+           double rms(norm(fock - h));
+
+           Expressions are evaluated Pack<T>::Width elements at a time using
+           the widest available SIMD instructions (see Simd.h).  Operands are
+           combined element by element in storage order, so all must have the
+           same length and Layout; assignment from a non-conforming
+           expression leaves the destination unchanged, and sum(), dot()
+           and norm() of one return zero.
+
+           Each expression type E provides:
+              Node node() const          -- the value stored in parent nodes
+              size_t length() const      -- 0 if the length is unconstrained
+              bool conforms(size_t n, Layout::Id) const
+              T operator[](size_t i) const
+              Pack<T> packet(size_t i) const
+ **/
+
+template <typename E, typename T>
+struct Expression {
+   typedef T value_type;
+   E const& self() const { return static_cast<E const&>(*this); }
+};
+
+
+// Elementwise operations, also used for compound assignment
+struct AssignOp { template <typename P> static P apply(P const&, P const& b) { return b; } };
+struct AddOp    { template <typename P> static P apply(P const& a, P const& b) { return a + b; } };
+struct SubOp    { template <typename P> static P apply(P const& a, P const& b) { return a - b; } };
+struct MulOp    { template <typename P> static P apply(P const& a, P const& b) { return a * b; } };
+struct DivOp    { template <typename P> static P apply(P const& a, P const& b) { return a / b; } };
+struct NegOp    { template <typename P> static P apply(P const& a) { return -a; } };
+
+
+/// Leaf node referring to contiguous data, e.g. that of an Array.
+template <typename T>
+class ExpressionTerminal : public Expression<ExpressionTerminal<T>, T> {
+
+   public:
+      typedef ExpressionTerminal Node;
+
+      ExpressionTerminal(T const* data, size_t length, Layout::Id const layout)
+       : m_data(data), m_length(length), m_layout(layout) { }
+
+      Node const& node() const { return *this; }
+      size_t length() const { return m_length; }
+
+      bool conforms(size_t n, Layout::Id const layout) const
+      {
+         return n == m_length && (layout == m_layout || n <= 1);
+      }
+
+      T operator[](size_t i) const { return m_data[i]; }
+      Pack<T> packet(size_t i) const { return Pack<T>::load(m_data+i); }
+
+   private:
+      T const*   m_data;
+      size_t     m_length;
+      Layout::Id m_layout;
+};
+
+
+/// Leaf node for a scalar, which is broadcast to all elements.
+template <typename T>
+class ExpressionScalar : public Expression<ExpressionScalar<T>, T> {
+
+   public:
+      typedef ExpressionScalar Node;
+
+      ExpressionScalar(T const value) : m_value(value) { }
+
+      Node const& node() const { return *this; }
+      size_t length() const { return 0; }
+      bool conforms(size_t, Layout::Id const) const { return true; }
+
+      T operator[](size_t) const { return m_value; }
+      Pack<T> packet(size_t) const { return Pack<T>::broadcast(m_value); }
+
+   private:
+      T m_value;
+};
+
+
+template <typename Op, typename L, typename R, typename T>
+class ExpressionBinary : public Expression<ExpressionBinary<Op, L, R, T>, T> {
+
+   public:
+      typedef ExpressionBinary Node;
+
+      ExpressionBinary(L const& l, R const& r) : m_l(l), m_r(r) { }
+
+      Node const& node() const { return *this; }
+      size_t length() const { return m_l.length() ? m_l.length() : m_r.length(); }
+
+      bool conforms(size_t n, Layout::Id const layout) const
+      {
+         return m_l.conforms(n, layout) && m_r.conforms(n, layout);
+      }
+
+      T operator[](size_t i) const { return Op::apply(m_l[i], m_r[i]); }
+      Pack<T> packet(size_t i) const { return Op::apply(m_l.packet(i), m_r.packet(i)); }
+
+   private:
+      L m_l;
+      R m_r;
+};
+
+
+template <typename Op, typename E, typename T>
+class ExpressionUnary : public Expression<ExpressionUnary<Op, E, T>, T> {
+
+   public:
+      typedef ExpressionUnary Node;
+
+      ExpressionUnary(E const& e) : m_e(e) { }
+
+      Node const& node() const { return *this; }
+      size_t length() const { return m_e.length(); }
+
+      bool conforms(size_t n, Layout::Id const layout) const
+      {
+         return m_e.conforms(n, layout);
+      }
+
+      T operator[](size_t i) const { return Op::apply(m_e[i]); }
+      Pack<T> packet(size_t i) const { return Op::apply(m_e.packet(i)); }
+
+   private:
+      E m_e;
+};
+
+
+/// Applies dst[i] = Op(dst[i], e[i]) for the n elements of dst.
+template <typename Op, typename T, typename E>
+void evaluate(T* dst, size_t n, E const& e)
+{
+   size_t const width(Pack<T>::Width);
+   size_t i(0);
+
+   if (width > 1) {
+      for (; i + width <= n; i += width) {
+          Op::apply(Pack<T>::load(dst+i), e.packet(i)).store(dst+i);
+      }
+   }
+
+   for (; i < n; ++i) {
+       dst[i] = Op::apply(dst[i], e[i]);
+   }
+}
+
+
+/// Returns true if the operands of the expression node e all have length n
+/// and share a Layout, as required for reducing it on its own.
+template <typename N>
+bool conforms(N const& e, size_t n)
+{
+   return e.conforms(n, Layout::ColumnMajor) || e.conforms(n, Layout::RowMajor);
+}
+
+
+/// Returns the sum of the elements of the expression.  Several partial sums
+/// are kept to hide the latency of the additions.
+template <typename E, typename T>
+T sum(Expression<E, T> const& expression)
+{
+   typename E::Node const e(expression.self().node());
+   size_t const n(e.length());
+   size_t const width(Pack<T>::Width);
+   size_t i(0);
+   T total(0);
+
+   if (!conforms(e, n)) {
+      LOG_WARN("Non-conforming expression reduced");
+      return total;
+   }
+
+   if (width > 1 && n >= 4*width) {
+      Pack<T> s0(Pack<T>::broadcast(0)), s1(s0), s2(s0), s3(s0);
+      for (; i + 4*width <= n; i += 4*width) {
+          s0 = s0 + e.packet(i);
+          s1 = s1 + e.packet(i+width);
+          s2 = s2 + e.packet(i+2*width);
+          s3 = s3 + e.packet(i+3*width);
+      }
+      total = ((s0 + s1) + (s2 + s3)).sum();
+   }
+
+   for (; i < n; ++i) {
+       total += e[i];
+   }
+
+   return total;
+}
+
+
+// Operators building expressions.  The scalar argument types are not deduced
+// so that, for example, 2*array works for Array<D,double>.
+
+template <typename L, typename R, typename T>
+ExpressionBinary<AddOp, typename L::Node, typename R::Node, T>
+operator+(Expression<L, T> const& l, Expression<R, T> const& r)
+{
+   return ExpressionBinary<AddOp, typename L::Node, typename R::Node, T>(
+      l.self().node(), r.self().node());
+}
+
+template <typename L, typename R, typename T>
+ExpressionBinary<SubOp, typename L::Node, typename R::Node, T>
+operator-(Expression<L, T> const& l, Expression<R, T> const& r)
+{
+   return ExpressionBinary<SubOp, typename L::Node, typename R::Node, T>(
+      l.self().node(), r.self().node());
+}
+
+template <typename L, typename R, typename T>
+ExpressionBinary<MulOp, typename L::Node, typename R::Node, T>
+operator*(Expression<L, T> const& l, Expression<R, T> const& r)
+{
+   return ExpressionBinary<MulOp, typename L::Node, typename R::Node, T>(
+      l.self().node(), r.self().node());
+}
+
+template <typename L, typename R, typename T>
+ExpressionBinary<DivOp, typename L::Node, typename R::Node, T>
+operator/(Expression<L, T> const& l, Expression<R, T> const& r)
+{
+   return ExpressionBinary<DivOp, typename L::Node, typename R::Node, T>(
+      l.self().node(), r.self().node());
+}
+
+template <typename E, typename T>
+ExpressionBinary<MulOp, ExpressionScalar<T>, typename E::Node, T>
+operator*(typename Expression<E, T>::value_type const s, Expression<E, T> const& e)
+{
+   return ExpressionBinary<MulOp, ExpressionScalar<T>, typename E::Node, T>(
+      ExpressionScalar<T>(s), e.self().node());
+}
+
+template <typename E, typename T>
+ExpressionBinary<MulOp, typename E::Node, ExpressionScalar<T>, T>
+operator*(Expression<E, T> const& e, typename Expression<E, T>::value_type const s)
+{
+   return ExpressionBinary<MulOp, typename E::Node, ExpressionScalar<T>, T>(
+      e.self().node(), ExpressionScalar<T>(s));
+}
+
+template <typename E, typename T>
+ExpressionBinary<DivOp, typename E::Node, ExpressionScalar<T>, T>
+operator/(Expression<E, T> const& e, typename Expression<E, T>::value_type const s)
+{
+   return ExpressionBinary<DivOp, typename E::Node, ExpressionScalar<T>, T>(
+      e.self().node(), ExpressionScalar<T>(s));
+}
+
+template <typename E, typename T>
+ExpressionBinary<AddOp, typename E::Node, ExpressionScalar<T>, T>
+operator+(Expression<E, T> const& e, typename Expression<E, T>::value_type const s)
+{
+   return ExpressionBinary<AddOp, typename E::Node, ExpressionScalar<T>, T>(
+      e.self().node(), ExpressionScalar<T>(s));
+}
+
+template <typename E, typename T>
+ExpressionBinary<SubOp, typename E::Node, ExpressionScalar<T>, T>
+operator-(Expression<E, T> const& e, typename Expression<E, T>::value_type const s)
+{
+   return ExpressionBinary<SubOp, typename E::Node, ExpressionScalar<T>, T>(
+      e.self().node(), ExpressionScalar<T>(s));
+}
+
+template <typename E, typename T>
+ExpressionUnary<NegOp, typename E::Node, T>
+operator-(Expression<E, T> const& e)
+{
+   return ExpressionUnary<NegOp, typename E::Node, T>(e.self().node());
+}
+
+
+/// Returns the inner product of two expressions
+template <typename L, typename R, typename T>
+T dot(Expression<L, T> const& l, Expression<R, T> const& r)
+{
+   return sum(l*r);
+}
+
+/// Returns the Euclidean norm of the expression
+template <typename E, typename T>
+T norm(Expression<E, T> const& e)
+{
+   return std::sqrt(dot(e, e));
+}
+
+} // end namespace
+
+#endif
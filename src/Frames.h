@@ -0,0 +1,151 @@
+#ifndef LIBQCH5_FRAMES_H
+#define LIBQCH5_FRAMES_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include <vector>
+#include "Array.h"
+
+
+namespace libqch5 {
+
+/// Non-template base for Frames that takes care of extending the dataset in
+/// file and writing out the buffered frames.
+class FramesBase : public ArrayBase {
+
+   friend class RawData;
+
+   public:
+      FramesBase(size_t batchSize);
+      ~FramesBase();
+
+      /// Total number of frames, both written and buffered.
+      size_t frameCount() const { return m_written + pending(); }
+
+      /// Number of frames buffered before they are written to file.
+      size_t batchSize() const { return m_batchSize; }
+
+      /// Writes any buffered frames to file.  Frames are held in memory
+      /// until the containing RawData object has been written to a
+      /// ProjectFile, after which they are written in batches.  Call this
+      /// once the last frame has been appended; the destructor also flushes,
+      /// but can only log a failure.
+      bool flush();
+
+      /// Returns true if the frames have been written to a ProjectFile.
+      bool isBound() const { return m_fileId >= 0; }
+
+   protected:
+      FramesBase(FramesBase const&);
+
+      /// Number of frames held in the buffer
+      virtual size_t pending() const = 0;
+      virtual void clearPending() = 0;
+
+      /// Associates the frames with the dataset name in group gid, after
+      /// the initial write of the pending frames.
+      void bind(hid_t gid, char const* name);
+
+      /// Flushes on destruction, logging an error with the number of frames
+      /// lost if the write fails.
+      void finalize();
+
+   private:
+      FramesBase& operator=(FramesBase const&);
+
+      size_t m_batchSize;
+      size_t m_written;
+      hid_t  m_fileId;
+      String m_path;
+};
+
+
+/** \brief An array of rank D+1 that is built up a frame at a time, for 
+           example the steps of a geometry optimization or MD trajectory.
+
+    \usage Frames are stored in a single extendable dataset in file with the
+           frame index as the last (slowest varying) dimension.  After the
+           containing RawData has been written, appended frames are buffered
+           and written in batches with a single extension of the dataset.
+
+           Frames<2>& traj(data.createFrames<2,double>({{3, nAtoms}}));
+           project.write("/Project/Molecule", data);
+
+           for (...) traj.append(coordinates);
+           traj.flush();
+
+           On reading, the frames are returned as an Array<D+1,T>.
+ **/
+
+template < size_t D, typename T = double >
+class Frames : public FramesBase {
+
+   public:
+      typedef typename Array<D,T>::Size Size;
+
+      Frames(Size const& frameSize, size_t batchSize = 64) 
+       : FramesBase(batchSize), m_frameLength(1)
+      {
+         for (size_t i = 0; i < D; ++i) {
+             m_dims[i] = frameSize[i];
+             m_frameLength *= frameSize[i];
+         }
+         m_dims[D] = 0;
+      }
+
+      ~Frames() { finalize(); }
+
+	  /// Copies are not bound to the file and hold only the frames that are
+	  /// yet to be written.
+      Frames* clone() const { return new Frames(*this); }
+
+      size_t rank() const { return D+1; }
+
+      hid_t h5DataType() const { return H5DataType(T()); }
+
+      /// Appends a frame, which must have the frame Size, returning false if
+      /// the frame does not fit or the batch could not be written.
+      template <typename Alloc>
+      bool append(Array<D,T,Alloc> const& frame)
+      {
+         for (size_t i = 0; i < D; ++i) {
+             if (frame.dim(i) != m_dims[i]) return false;
+         }
+
+         if (m_frameLength > 0) {
+            m_buffer.insert(m_buffer.end(), &frame[0], &frame[0] + m_frameLength);
+         }
+         ++m_dims[D];
+
+         return (isBound() && pending() >= batchSize()) ? flush() : true;
+      }
+
+   protected:
+      void* buffer() { return m_buffer.data(); }
+      void const* buffer() const { return m_buffer.data(); }
+
+      size_t const* dimensions() const { return m_dims.data(); }
+
+      size_t pending() const { return m_dims[D]; }
+
+      void clearPending() 
+      { 
+         m_buffer.clear(); 
+         m_dims[D] = 0; 
+      }
+
+   private:
+      size_t m_frameLength;
+      std::array<size_t, D+1> m_dims; 
+      std::vector<T> m_buffer;
+};
+
+} // end namespace
+
+#endif
@@ -1,3 +1,5 @@
+#ifndef LIBQCH5_GEOMETRY_H
+#define LIBQCH5_GEOMETRY_H
 /*******************************************************************************
 
   This file is part of libqch5 a data file format for managing quantum 
@@ -26,9 +28,21 @@ class Geometry : public RawData {
 
       void setUnits();
 
+      /// Creates a trajectory of 3 x nAtoms coordinate frames, for example
+      /// the steps of an optimization.  Once the Geometry has been written,
+      /// frames are written to file in batches of batchSize.
+      Frames<2>& createTrajectory(size_t nAtoms, size_t batchSize = 64);
+
+      /// Appends a 3 x nAtoms frame to the trajectory, returning false if no
+      /// trajectory has been created or the frame has the wrong shape.
+      bool appendFrame(Array<2> const& coordinates);
+
    private:
       unsigned m_nAtoms;
       Units m_units;
+      int   m_trajectory;  // array index of the trajectory frames
 };
 
 } // end namespace
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef LIBQCH5_GROUPCACHE_H
+#define LIBQCH5_GROUPCACHE_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include <list>
+#include "hdf5.h"
+#include "Types.h"
+#include "DataType.h"
+
+
+namespace libqch5 {
+
+/// Caches open group handles and the DataType of groups in a file, keyed on
+/// the group path.  The number of open handles is bounded, with the least
+/// recently used handle closed first.  Resolved DataTypes are cheap to hold
+/// and are kept until invalidated.
+class GroupCache {
+
+   public:
+      GroupCache(size_t capacity = 64) : m_capacity(capacity > 0 ? capacity : 1) { }
+      ~GroupCache() { clear(); }
+
+      /// Returns an open handle for the group path in the file fid, or a 
+      /// negative value if the group could not be opened.  If create is set
+      /// and the group does not exist it is created.  The handle is owned by
+      /// the cache and must not be closed by the caller.
+      hid_t open(hid_t fid, String const& path, bool create = false);
+
+      /// Sets type to the cached DataType of path, if known.
+      bool getDataType(String const& path, DataType& type) const;
+      void setDataType(String const& path, DataType const& type);
+
+      /// Removes path, and anything below it, from the cache.
+      void invalidate(String const& path);
+
+      /// Closes all handles and forgets all DataTypes.
+      void clear();
+
+      /// Sets the maximum number of open handles, which is at least one.
+      void setCapacity(size_t capacity);
+
+      /// Returns path in a canonical form, with a single leading '/' and
+      /// no trailing or repeated '/'.
+      static String normalize(String const& path);
+
+   private:
+      GroupCache(GroupCache const&);
+      GroupCache& operator=(GroupCache const&);
+
+      typedef std::pair<String, hid_t> Entry;
+      typedef std::list<Entry> Lru;
+
+      void evict(size_t capacity);
+      void close(StringMap<Lru::iterator>::iterator);
+
+      size_t m_capacity;
+      Lru    m_lru;    // most recently used at the front
+      StringMap<Lru::iterator> m_handles;
+      StringMap<DataType>      m_dataTypes;
+};
+
+} // end namespace
+
+#endif
@@ -11,13 +11,34 @@
 
 #include "hdf5.h"
 #include "Types.h"
+#include <complex>
+#include <cstdint>
 
 
 namespace libqch5 {
 
-inline hid_t H5DataType(double) { return H5T_NATIVE_DOUBLE; }
-inline hid_t H5DataType(int)    { return H5T_NATIVE_INT; }
-inline hid_t H5DataType(String) { return H5T_STRING; }
+/// Compound of two doubles, "r" and "i", as used by h5py for complex data.
+hid_t H5ComplexType();
+
+/// Variable length C string
+hid_t H5StringType();
+
+inline hid_t H5DataType(double)   { return H5T_NATIVE_DOUBLE; }
+inline hid_t H5DataType(float)    { return H5T_NATIVE_FLOAT; }
+inline hid_t H5DataType(int)      { return H5T_NATIVE_INT; }
+inline hid_t H5DataType(int64_t)  { return H5T_NATIVE_INT64; }
+inline hid_t H5DataType(uint8_t)  { return H5T_NATIVE_UINT8; }
+inline hid_t H5DataType(String)   { return H5StringType(); }
+inline hid_t H5DataType(std::complex<double>) { return H5ComplexType(); }
+
+/// Names recorded for the element type of arrays stored as a different type
+/// on disk, see StoragePolicy::setFileType().
+inline char const* H5TypeName(double)   { return "double"; }
+inline char const* H5TypeName(float)    { return "float"; }
+inline char const* H5TypeName(int)      { return "int"; }
+inline char const* H5TypeName(int64_t)  { return "int64"; }
+inline char const* H5TypeName(uint8_t)  { return "uint8"; }
+inline char const* H5TypeName(std::complex<double>) { return "complex"; }
 
 
 /// Convenience function that attempts to open a group, and if that fails,
@@ -0,0 +1,49 @@
+#ifndef LIBQCH5_HYPERSLAB_H
+#define LIBQCH5_HYPERSLAB_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include <array>
+#include <cstddef>
+
+
+namespace libqch5 {
+
+/** \brief Selects a regular sub-block of an array of rank D for partial reads.
+
+    \usage Indices follow the same (column major) ordering as Array::Index.
+           To read columns 10-14 of an n x m matrix:
+
+           Hyperslab<2> slab({0, 10}, {n, 5});
+           Array<2> block;
+           project.read("/Project/Molecule/Geometry", 0, slab, block);
+
+           A stride may also be given, in which case count[i] elements are
+           selected starting at offset[i] and separated by stride[i].
+ **/
+
+template <size_t D>
+struct Hyperslab {
+
+   typedef std::array<size_t, D> Index;
+
+   Hyperslab(Index const& offset_, Index const& count_)
+    : offset(offset_), count(count_) { stride.fill(1); }
+
+   Hyperslab(Index const& offset_, Index const& count_, Index const& stride_)
+    : offset(offset_), count(count_), stride(stride_) { }
+
+   Index offset;
+   Index count;
+   Index stride;
+};
+
+} // end namespace
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef LIBQCH5_LAYOUT_H
+#define LIBQCH5_LAYOUT_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include "hdf5.h"
+#include <array>
+#include <cstddef>
+
+
+namespace libqch5 {
+
+/** \brief Memory ordering of the elements of an Array.
+
+    \usage The ordering is recorded as a string attribute named Layout on each
+           dataset written.  ColumnMajor arrays are stored with their
+           dimensions reversed, RowMajor arrays as they are, so that in both
+           cases the file data is the memory buffer and no reordering is
+           required on write.  On reading, data are only reordered if the
+           requested layout differs from that of the file.  Datasets without
+           the attribute were written before it was introduced and hold
+           ColumnMajor data with the dimensions in Array order; these are
+           still read in that order.
+ **/
+
+class Layout {
+
+   public:
+      enum Id { ColumnMajor, RowMajor };
+
+      static char const* toString(Id const);
+
+      /// Returns the layout recorded for the dataset did, ColumnMajor if
+      /// none has been recorded.
+      static Id read(hid_t did);
+
+      /// Returns false if the dataset did predates the Layout attribute, in
+      /// which case its dimensions are not reversed.
+      static bool isRecorded(hid_t did);
+
+      /// Records the layout for the dataset path in the group gid.
+      static bool write(hid_t gid, char const* path, Id const);
+
+   private:
+      static char const* AttributeName;
+};
+
+
+/// Layout policy for Array in which the first index varies fastest.
+struct ColumnMajor {
+
+   static Layout::Id const id = Layout::ColumnMajor;
+
+   /// Sets the element strides for each dimension, returning the length.
+   template <size_t D>
+   static size_t strides(std::array<size_t, D> const& dims, std::array<size_t, D>& strides)
+   {
+      size_t length(1);
+      for (size_t i = 0; i < D; ++i) {
+          strides[i] = length;
+          length *= dims[i];
+      }
+      return length;
+   }
+};
+
+
+/// Layout policy for Array in which the last index varies fastest, as used
+/// by C, numpy and HDF5.
+struct RowMajor {
+
+   static Layout::Id const id = Layout::RowMajor;
+
+   template <size_t D>
+   static size_t strides(std::array<size_t, D> const& dims, std::array<size_t, D>& strides)
+   {
+      size_t length(1);
+      for (size_t i = D; i > 0; --i) {
+          strides[i-1] = length;
+          length *= dims[i-1];
+      }
+      return length;
+   }
+};
+
+} // end namespace
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef LIBQCH5_LOGGER_H
+#define LIBQCH5_LOGGER_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include <atomic>
+#include <functional>
+#include <sstream>
+#include "Types.h"
+
+
+/// Messages above this level are removed at compile time, so they cost
+/// nothing, not even the formatting of their arguments.  Values follow
+/// Logger::Level, the default of 3 keeps Error, Warn and Info messages.
+#ifndef LIBQCH5_LOG_LEVEL
+#define LIBQCH5_LOG_LEVEL 3
+#endif
+
+
+namespace libqch5 {
+
+/// Library wide message logging.  Messages that pass both the compile time
+/// level and the runtime level are formatted and passed to the Sink, which
+/// by default writes to std::cerr.  The level and sink are process wide and
+/// may be used from any thread; calls to the Sink are serialized.
+class Logger {
+
+   public:
+      enum Level { Off = 0, Error, Warn, Info, Debug };
+
+      typedef std::function<void(Level, String const&)> Sink;
+
+      static Level level() { return static_cast<Level>(s_level.load()); }
+      static void setLevel(Level level) { s_level = level; }
+
+      static bool enabled(Level level)
+      {
+         return level <= s_level.load(std::memory_order_relaxed);
+      }
+
+      /// Replaces the message sink.  An empty Sink restores the default.
+      static void setSink(Sink const& sink);
+
+      static void write(Level level, String const& message);
+
+      static char const* toString(Level level);
+
+   private:
+      static std::atomic<int> s_level;
+};
+
+} // end namespace
+
+
+#define LOG_ENABLED(level) \
+   ((level) <= LIBQCH5_LOG_LEVEL && ::libqch5::Logger::enabled(level))
+
+#define LOG_MESSAGE(level, x) do { if (LOG_ENABLED(level)) { \
+   std::ostringstream os_; os_ << x; ::libqch5::Logger::write(level, os_.str()); \
+   } } while (0)
+
+#define LOG_ERROR(x) LOG_MESSAGE(::libqch5::Logger::Error, x)
+#define LOG_WARN(x)  LOG_MESSAGE(::libqch5::Logger::Warn,  x)
+#define LOG_INFO(x)  LOG_MESSAGE(::libqch5::Logger::Info,  x)
+#define LOG_DEBUG(x) LOG_MESSAGE(::libqch5::Logger::Debug, x)
+
+#endif
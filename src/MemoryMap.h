@@ -0,0 +1,48 @@
+#ifndef LIBQCH5_MEMORYMAP_H
+#define LIBQCH5_MEMORYMAP_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include <cstddef>
+
+
+namespace libqch5 {
+
+/// Private, read-only mapping of a region of a file into memory.  The region
+/// need not be page aligned.  Writes to the mapped memory are copy-on-write
+/// and are never carried through to the file.  The mapping is released when
+/// the object is destroyed.
+class MemoryMap {
+
+   public:
+      MemoryMap(char const* filePath, size_t offset, size_t length);
+      ~MemoryMap();
+
+      bool isValid() const { return m_data != 0; }
+
+      /// Returns a pointer to the start of the requested region.
+      void* data() const { return m_data; }
+      size_t length() const { return m_length; }
+
+      /// Returns the granularity of mapping offsets.
+      static size_t pageSize();
+
+   private:
+      MemoryMap(MemoryMap const&);
+      MemoryMap& operator=(MemoryMap const&);
+
+      void*  m_base;
+      size_t m_mappedLength;
+      void*  m_data;
+      size_t m_length;
+};
+
+} // end namespace
+
+#endif
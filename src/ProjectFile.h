@@ -10,9 +10,21 @@
 ********************************************************************************/
 
 #include "hdf5.h"
+#include "AttributeIndex.h"
 #include "Schema.h"
+#include "Array.h"
+#include "Hyperslab.h"
+#include "StoragePolicy.h"
+#include "GroupCache.h"
+#include "Logger.h"
 #include "Types.h"
 
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
 
 namespace libqch5 {
 
@@ -22,14 +34,29 @@ class ProjectFile {
 
    public:
       enum IOStat { Closed, Open };
-      enum IOMode { New, Old, Overwrite };
-      enum LogLevel { Off = 0, Error, Warn, Info };
+      enum IOMode { New, Old, Overwrite, ReadOnly };
+      enum LogLevel { Off   = Logger::Off, 
+                      Error = Logger::Error, 
+                      Warn  = Logger::Warn, 
+                      Info  = Logger::Info, 
+                      Debug = Logger::Debug };
+      enum ReadMode { Eager, Lazy, Mapped };
+
+      /// Result of an asynchronous write, with the reason for any failure.
+      struct WriteResult {
+         WriteResult(bool ok = false, String const& error = String())
+          : ok(ok), error(error) { }
+         operator bool() const { return ok; }
+         bool   ok;
+         String error;
+      };
       
       // Initializes a new ProjectFile with the given file path.  For files with
       // IOMode set to New or Overwrite, the Schema should be passed in to the
       // constructor.  For exisiting (Old) files the Schema is read in from the 
       // file.  If a Schema is also specified, a check is made to ensure matching
-      // Schemata.
+      // Schemata.  ReadOnly opens an existing file as for Old, but all writes
+      // fail and the attribute index is not saved.
 	  ProjectFile(char const* filePath, IOMode const = Old, Schema const& = Schema());
 
       ~ProjectFile();
@@ -39,27 +66,142 @@ class ProjectFile {
 
       // Writes the given data object as a child of the path
       bool write(char const* path, RawData const& data);
+
+      // Writes the data object to a path determined from its DataType.  Not
+      // yet implemented, always returns false.
       bool write(RawData const& data);
 
+      /// Queues the data to be written as a child of the path by a background
+      /// I/O thread, which is started on first use.  The contents of data are
+      /// taken over, leaving it empty.  If the queue is full the call blocks
+      /// until a slot becomes free.  The future holds the result of the write,
+      /// error() is not set by failed asynchronous writes.  All other
+      /// operations on the file, including changes to its settings, first
+      /// wait for the queue to drain, so they observe the queued writes in
+      /// order.  Unless HDF5 has been built thread-safe, the caller must not
+      /// make other HDF5 calls (e.g. lazy loads, Frames appends) while
+      /// writes are pending.
+      std::future<WriteResult> writeAsync(char const* path, RawData&& data);
+
+      /// Waits until all queued asynchronous writes have completed.
+      void drain() const;
+
+      /// Drains the write queue and flushes the file buffers to disk.
+      bool flush();
+
+      /// Sets the maximum number of pending asynchronous writes.
+      void setAsyncQueueSize(size_t size);
+
+      // Writes each of the data objects as a child of the path.  The path is
+      // checked once for each DataType and the parent group is held open for
+      // all the writes.  On return, status holds the result for each object
+      // and true is returned only if all were written.
+      bool write(char const* path, List<RawData const*> const& data, List<bool>& status);
+
       // Reads the given data object as a child of the path
       bool read(char const* path, RawData& data);
 
+      // Reads a sub-block of the index'th array of the data object at path,
+      // resizing array to the Hyperslab count.  Only the selected elements
+      // are read from file.
+      template <size_t D, typename T, typename Alloc, typename Order>
+      bool read(char const* path, size_t index, Hyperslab<D> const& slab, 
+         Array<D,T,Alloc,Order>& array)
+      {
+         array.resize(slab.count);
+         return read(path, index, D, slab.offset.data(), slab.count.data(),
+            slab.stride.data(), array);
+      }
+
       // Adds the specified group
       bool addGroup(char const* path, DataType const& = DataType(DataType::Group));
 
       // Checks if the path currently exists in the file
       bool pathExists(char const* path) const;
 
-      void setLogLevel(LogLevel logLevel) { m_logLevel = logLevel; }
+      /// Default maximum number of pending asynchronous writes.
+      static size_t const AsyncQueueSize = 4;
+
+      /// Sets the level for messages reported by this file only.  Diagnostics
+      /// from the rest of the library are controlled process wide with
+      /// Logger::setLevel().  Messages above LIBQCH5_LOG_LEVEL are compiled
+      /// out regardless.
+      void setLogLevel(LogLevel logLevel);
+
+      /// In Lazy mode, read() only reads the attributes and array metadata,
+      /// the array data are read when first accessed via RawData::getArray().
+      /// In Mapped mode contiguous arrays are memory mapped from the file and
+      /// returned as non-owning views; other arrays are read as usual.
+      void setReadMode(ReadMode readMode) { m_readMode = readMode; }
+
+      /// Sets the maximum number of group handles held open by the file,
+      /// which is at least one.
+      void setCacheSize(size_t size);
+
+      /// Datasets at least this size are aligned to page boundaries in the
+      /// file so they can be mapped efficiently.
+      static hsize_t const AlignmentThreshold = 1 << 16;
+
+      /// Sets the default StoragePolicy used for arrays that do not specify
+      /// one of their own.
+      void setStoragePolicy(StoragePolicy const& policy);
+      StoragePolicy const& storagePolicy() const { return m_storagePolicy; }
+
+      /// Sets the attribute keys recorded in the AttributeIndex of the file.
+      /// The index is updated as objects are written and saved by flush()
+      /// and on closing.  Objects written before a key was added are not
+      /// found until rebuildIndex() is called.
+      void setIndexedKeys(List<String> const& keys);
+      List<String> indexedKeys() const;
+
+      /// Sets paths to the objects satisfying the query, using only the
+      /// index.  Returns false if a key in the query is not indexed, or if
+      /// the file was changed without updating the index, in which case it
+      /// must be rebuilt.
+      bool find(IndexQuery const& query, List<String>& paths);
+
+      /// Rebuilds the index from the attributes of every group in the file.
+      bool rebuildIndex();
 
 
    private:
+      struct WriteJob {
+         String path;
+         std::unique_ptr<RawData> data;
+         std::promise<WriteResult> result;
+      };
+
+      /// Implementations of the public functions, without draining the
+      /// asynchronous write queue first.
+      /// writeData() sets error, rather than m_error, as it is also run on
+      /// the I/O thread.
+      bool writeData(char const* path, RawData const& data, String& error);
+      bool exists(char const* path) const;
+
+      /// Records the attributes of data, written as a child of path, in
+      /// the index.
+      void index(char const* path, RawData const& data);
+
+      /// Writes the index to file if it has changed
+      bool saveIndex();
+
+      static herr_t indexGroup(hid_t gid, char const* name, H5L_info_t const*, void* index);
+
+      /// Body of the background I/O thread.
+      void writeLoop();
+
+      /// Drains the queue and joins the I/O thread.
+      void stopWriter();
+
       // Performs a check to see if the DataType can be written to the group
       // given by path.  
       bool pathCheck(char const* path, DataType const&) const;
 
       DataType getDataType(char const* path) const;
 
+      bool read(char const* path, size_t index, size_t rank, size_t const* offset,
+         size_t const* count, size_t const* stride, ArrayBase& array);
+
 	  void open(char const* filePath, IOMode const = Old, Schema const& = Schema());
 
       /// Closes the attached file, updating m_ioStat.
@@ -80,6 +222,20 @@ class ProjectFile {
       IOStat   m_ioStat;
       Schema   m_schema;
       LogLevel m_logLevel;
+      ReadMode m_readMode;
+      mutable GroupCache m_groupCache;
+      StoragePolicy m_storagePolicy;
+      AttributeIndex m_index;
+
+      // Asynchronous write queue, guarded by m_queueMutex.  m_writing is set
+      // while the I/O thread has a job in hand.
+      std::thread m_writer;
+      mutable std::mutex m_queueMutex;
+      mutable std::condition_variable m_queueChanged;
+      std::deque<WriteJob> m_queue;
+      size_t m_queueSize;
+      bool   m_writing;
+      bool   m_stopWriter;
 };
 
 } // end namespace
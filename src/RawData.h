@@ -11,6 +11,10 @@
 
 #include "hdf5.h"
 #include "Array.h"
+#include "ArrayView.h"
+#include "BlockSparse.h"
+#include "Frames.h"
+#include "SymmetricArray.h"
 #include "Types.h"
 #include "DataType.h"
 #include "Attributes.h"
@@ -24,18 +28,36 @@ class RawData {
    public:
        RawData( DataType::Id const& type = DataType::Base,
           String const& label = "Untitled")
-        : m_label(label), m_type(type) { }
+        : m_label(label), m_type(type), m_layout(Layout::ColumnMajor), m_fileId(-1) { }
 
-       RawData(RawData const& that) {  copy(that); }
+       RawData(RawData const& that) : m_fileId(-1) {  copy(that); }
+
+       /// Takes over the arrays and attributes of that, leaving it empty.
+       RawData(RawData&& that) 
+        : m_type(DataType::Invalid), m_layout(Layout::ColumnMajor), m_fileId(-1) 
+       { 
+          swap(that); 
+       }
 
        ~RawData() { destroy(); }
 
        RawData& operator=(RawData const& that);
+       RawData& operator=(RawData&& that);
+
+       /// Exchanges the contents, including any arrays, with that.  This
+       /// allows data to be handed over without copying the arrays.
+       void swap(RawData& that);
     
        void setLabel(String const& label) { m_label = label; }
        String const& label() const { return m_label; }
        DataType const& dataType() const { return m_type; }
 
+       /// Sets the layout of arrays subsequently read into this object,
+       /// ColumnMajor by default.  Data are reordered on reading only if the
+       /// layout differs from that in which they were written.
+       void setLayout(Layout::Id const layout) { m_layout = layout; }
+       Layout::Id layout() const { return m_layout; }
+
        template <typename T>
        void setAttribute(String const& name, T const& value) {
           m_attributes.set(name, value);
@@ -46,6 +68,10 @@ class RawData {
           return m_attributes.get(name, value);
        }
 
+       /// Writes the attributes as a single compound attribute, see
+       /// Attributes::setPacked().
+       void setPackedAttributes(bool packed) { m_attributes.setPacked(packed); }
+
 
        /// Allocates a new Array<D,T> of Size and appends it to the list of
        /// known data.
@@ -57,6 +83,156 @@ class RawData {
           return *d;
        }
 
+       /// Appends the array to the list of known data, taking over its buffer.
+       template < size_t D, typename T, typename Alloc, typename Order>
+       Array<D, T, Alloc, Order>& createArray(Array<D, T, Alloc, Order>&& array)
+       {
+          Array<D, T, Alloc, Order>* d(new Array<D,T,Alloc,Order>(std::move(array)));
+          m_arrays.push_back(d);
+          return *d;
+       }
+
+       /// Appends an Array of Size over existing data without copying.  The
+       /// owner handle is held for the lifetime of the Array and is
+       /// responsible for releasing the data.
+       template < size_t D, typename T>
+       Array<D, T>& createArray(typename Array<D, T>::Size const& size, T* data, 
+          std::shared_ptr<void> const& owner)
+       {
+          Array<D, T>* d(new Array<D,T>(size, data, owner));
+          m_arrays.push_back(d);
+          return *d;
+       }
+
+       /// As above, adopting a buffer allocated with new[].
+       template < size_t D, typename T>
+       Array<D, T>& createArray(typename Array<D, T>::Size const& size, 
+          std::unique_ptr<T[]>&& data)
+       {
+          T* p(data.get());
+          return createArray<D,T>(size, p, std::shared_ptr<void>(std::move(data)));
+       }
+
+       /// As above, adopting the contents of a vector, which is padded if it
+       /// holds fewer elements than Size requires.
+       template < size_t D, typename T>
+       Array<D, T>& createArray(typename Array<D, T>::Size const& size, 
+          std::vector<T>&& data)
+       {
+          size_t length(1);
+          for (size_t i = 0; i < D; ++i) length *= size[i];
+          if (data.size() < length) data.resize(length);
+
+          std::shared_ptr<std::vector<T> > owner(new std::vector<T>(std::move(data)));
+          return createArray<D,T>(size, owner->data(), owner);
+       }
+
+
+       /// Allocates a new n by n SymmetricArray, of which only the packed
+       /// lower triangle is written.
+       template <typename T = double>
+       SymmetricArray<T>& createSymmetricArray(size_t n)
+       {
+          SymmetricArray<T>* d(new SymmetricArray<T>(n));
+          m_arrays.push_back(d);
+          return *d;
+       }
+
+       /// Appends the symmetric array to the list of known data, taking over
+       /// its buffer.
+       template <typename T, typename Alloc>
+       SymmetricArray<T, Alloc>& createArray(SymmetricArray<T, Alloc>&& array)
+       {
+          SymmetricArray<T, Alloc>* d(new SymmetricArray<T, Alloc>(std::move(array)));
+          m_arrays.push_back(d);
+          return *d;
+       }
+
+       /// Creates a new, empty, BlockSparseArray<D,T> divided into blocks of
+       /// blockSize elements.  Only the blocks inserted are written.
+       template < size_t D, typename T>
+       BlockSparseArray<D, T>& createBlockSparseArray(
+          typename BlockSparseArray<D, T>::Size const& size,
+          typename BlockSparseArray<D, T>::Size const& blockSize)
+       {
+          BlockSparseArray<D, T>* b(new BlockSparseArray<D,T>(size, blockSize));
+          m_arrays.push_back(b);
+          return *b;
+       }
+
+       /// Appends a copy of the view to the list of known data.  Only the
+       /// view is copied, the viewed data must remain valid until written.
+       template < size_t D, typename T>
+       ArrayView<D, T>& createView(ArrayView<D, T> const& view)
+       {
+          ArrayView<D, T>* v(new ArrayView<D,T>(view));
+          m_arrays.push_back(v);
+          return *v;
+       }
+
+       /// Returns the number of arrays, including those yet to be loaded.
+       size_t arrayCount() const { return m_arrays.size(); }
+
+       /// Returns the dimensions of the index'th array.  For lazily read data
+       /// this does not require the array to be loaded.
+       List<size_t> arrayDimensions(size_t index) const;
+
+       /// Returns true if the index'th array is resident in memory.
+       bool isLoaded(size_t index) const;
+
+       /// Returns the index'th array, reading it from file if required.  A
+       /// null pointer is returned if the index is out of range, or the
+       /// array could not be loaded.
+       ArrayBase* getArray(size_t index);
+       ArrayBase const* getArray(size_t index) const;
+
+       /// As above, but also returns null if the array is not an Array<D,T>
+       /// of the given Order, which should match layout().
+       template < size_t D, typename T, typename Order = ColumnMajor>
+       Array<D, T, AlignedAllocator<T>, Order>* getArray(size_t index)
+       {
+          return dynamic_cast<Array<D, T, AlignedAllocator<T>, Order>*>(getArray(index));
+       }
+
+       /// As above, but returns null if the array is not a SymmetricArray<T>.
+       template <typename T>
+       SymmetricArray<T>* getSymmetricArray(size_t index)
+       {
+          return dynamic_cast<SymmetricArray<T>*>(getArray(index));
+       }
+
+       /// As above, but returns null if the array is not a
+       /// BlockSparseArray<D,T>.
+       template < size_t D, typename T>
+       BlockSparseArray<D, T>* getBlockSparseArray(size_t index)
+       {
+          return dynamic_cast<BlockSparseArray<D, T>*>(getArray(index));
+       }
+
+       /// Creates a new, empty, Frames<D,T> object that is appended to the
+       /// list of known data.  Frames added after this object has been 
+       /// written are streamed to file in batches of batchSize.
+       template < size_t D, typename T>
+       Frames<D, T>& createFrames(typename Array<D, T>::Size const& frameSize,
+          size_t batchSize = 64)
+       {
+          Frames<D, T>* f(new Frames<D,T>(frameSize, batchSize));
+          m_arrays.push_back(f);
+          return *f;
+       }
+
+       /// Appends a frame to the index'th array, which must have been created
+       /// with createFrames<D,T>.
+       template < size_t D, typename T, typename Alloc>
+       bool appendFrame(size_t index, Array<D, T, Alloc> const& frame)
+       {
+          Frames<D, T>* f(index < m_arrays.size() ?
+             dynamic_cast<Frames<D,T>*>(m_arrays[index]) : 0);
+          return f && f->append(frame);
+       }
+
+       /// Writes any buffered frames to file.
+       bool flush();
 
        // Convenience functions for creating arrays of rank 1-3
        template <typename T = double>
@@ -84,26 +260,131 @@ class RawData {
    protected:
        void setDataType(DataType const type) { m_type = type; }
 
-       bool write(hid_t gid) const;
+       /// Writes the data as a subgroup of gid.  Arrays without a StoragePolicy
+       /// of their own are written using the given default.
+       bool write(hid_t gid, StoragePolicy const& = StoragePolicy()) const;
 
 	   /// Attempts to read the data contained in the gid into this object.  It
 	   /// is assumed the label has been set appropriately before calling this
-	   /// function.
-       bool read(hid_t gid);
+	   /// function.  If lazy is set, only the array metadata is read and
+	   /// the arrays are loaded on first access via getArray().  If mapped
+	   /// is set, contiguous datasets are memory mapped rather than read.
+       bool read(hid_t gid, bool lazy = false, bool mapped = false);
 
    private:
+       /// Attribute holding the original element type of arrays stored as
+       /// a different type, see StoragePolicy::setFileType().
+       static char const* ElementTypeAttribute;
+
+       /// Records the name, type and shape of an array in file that has
+       /// yet to be loaded.
+       struct ArrayHandle {
+          String        name;
+          hid_t         type;
+          List<size_t>  dims;
+          Structure::Id structure;
+       };
+
        void copy(RawData const&);
        void destroy();
+       void clearArrays();
 
        bool write(hid_t fid, char const* path, hid_t tid, size_t rank, 
-          hsize_t const* dimensions, void const* data) const;
+          hsize_t const* dimensions, void const* data, StoragePolicy const&,
+          hsize_t const* maxDimensions = 0, hid_t memorySpace = H5S_ALL) const;
+
+       /// Writes the block sparse array as the subgroup path of gid, holding
+       /// the Index and Values datasets.
+       bool write(hid_t gid, char const* path, BlockSparseBase const&, 
+          StoragePolicy const&) const;
+
+       /// Reads the dataset at path into the index'th array.  Block sparse
+       /// arrays are read from the subgroup path.
+       bool read(hid_t gid, char const* path, size_t index, bool mapped = false) const;
+
+       /// Reads the block sparse array in the subgroup path of gid into the
+       /// index'th array.  If lazy is set only the metadata are read.
+       bool readBlockSparse(hid_t gid, char const* path, size_t index, 
+          bool lazy = false) const;
+
+       /// Creates an empty BlockSparseArray of the given type and shape.
+       static ArrayBase* newBlockSparseArray(hid_t type, size_t rank, size_t const* dims,
+          size_t const* blockSize);
+
+       /// Returns a view of the dataset did mapped directly from the file,
+       /// or null if the dataset is not stored contiguously.
+       static ArrayBase* mapArray(hid_t did, hid_t type, size_t rank, size_t const* dims,
+          Layout::Id const);
+
+       /// Records the metadata of the dataset at path for a later load().
+       bool readHandle(hid_t gid, char const* path, size_t index);
+
+       bool load(size_t index) const;
 
-       bool read(hid_t gid, char const* path);
+       /// Drops the reference to the file once no arrays remain to be loaded.
+       void releaseFile() const;
+
+       /// Returns the slot in m_arrays for the dataset name in a group of
+       /// count objects, growing the list as required.
+       size_t arrayIndex(char const* name, size_t count) const;
+
+       /// Returns the native type corresponding to the file type tid, or a
+       /// negative value if the type is not supported.
+       static hid_t nativeType(hid_t tid);
+
+       /// Returns the native type the dataset did is read as.  This is the
+       /// original type of arrays stored as a different type, which is
+       /// recorded in the ElementTypeAttribute.
+       static hid_t elementType(hid_t did);
+
+       /// Creates an Array of the given type, dimensions and layout.  If data
+       /// is given the Array is a non-owning view, kept valid by owner.
+       static ArrayBase* newArray(hid_t type, size_t rank, size_t const* dims,
+          Layout::Id const, void* data = 0, 
+          std::shared_ptr<void> const& owner = std::shared_ptr<void>());
+
+       /// Creates a SymmetricArray of the given type holding length packed
+       /// elements, or returns null if length is not triangular.
+       static ArrayBase* newSymmetricArray(hid_t type, size_t length);
+
+       /// Returns the Array dimensions for a dataset with the HDF5 (row major)
+       /// dimensions dims, written with the given layout.
+       static List<size_t> arrayShape(size_t rank, hsize_t const* dims, 
+          Layout::Id const);
+
+       /// Reads the selection fileSpace of the dataset did into buffer.  For
+       /// a hyperslab selection count gives its (row major) shape.  If
+       /// reorder is set the data are converted between row and column major
+       /// order.
+       static bool readData(hid_t did, hid_t type, hid_t fileSpace, size_t rank,
+          hsize_t const* count, bool reorder, void* buffer);
+
+       /// Reads a hyperslab of the dataset at path into array, which must
+       /// already be sized to hold count elements in each dimension.  The
+       /// selection is given in Array (column major) order.
+       static bool read(hid_t gid, char const* path, size_t rank, 
+          size_t const* offset, size_t const* count, size_t const* stride,
+          ArrayBase& array);
+
+       /// Selects, in the file space fsid, the elements of a hyperslab of a
+       /// dataset with no recorded layout and dimensions dims, ordered as
+       /// they are stored in an array of the given layout.
+       static bool selectLegacy(hid_t fsid, size_t rank, hsize_t const* dims, 
+          size_t const* offset, size_t const* count, size_t const* stride, 
+          Layout::Id const);
 
        String   m_label;
        DataType m_type;
-       List< ArrayBase*>  m_arrays;
+       Layout::Id m_layout;
        Attributes m_attributes;
+
+       // Unloaded arrays are held as null pointers in m_arrays, with their
+       // ArrayHandle in m_handles.  A reference to the file is held in
+       // m_fileId until all have been loaded or the data is destroyed.
+       mutable hid_t  m_fileId;
+       mutable String m_path;
+       mutable List<ArrayBase*> m_arrays;
+       mutable std::map<size_t, ArrayHandle> m_handles;
 };
 
 } // end namespace
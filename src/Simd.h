@@ -0,0 +1,157 @@
+#ifndef LIBQCH5_SIMD_H
+#define LIBQCH5_SIMD_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include <cstddef>
+
+// The instruction set is chosen at compile time from the target flags, e.g.
+// -mavx2 or -march=native.  Define LIBQCH5_NO_SIMD to force the scalar code.
+#ifndef LIBQCH5_NO_SIMD
+ #if defined(__AVX512F__)
+  #define LIBQCH5_SIMD_AVX512
+ #elif defined(__AVX2__) || defined(__AVX__)
+  #define LIBQCH5_SIMD_AVX2
+ #endif
+#endif
+
+#if defined(LIBQCH5_SIMD_AVX512) || defined(LIBQCH5_SIMD_AVX2)
+ #include <immintrin.h>
+#endif
+
+
+namespace libqch5 {
+
+/** \brief A short vector of Width elements of type T held in a SIMD register.
+           The generic version holds a single element and provides the scalar
+           fallback for types and targets without a specialization.
+ **/
+
+template <typename T>
+struct Pack {
+
+   static size_t const Width = 1;
+
+   T v;
+
+   static Pack load(T const* p) { Pack r; r.v = *p; return r; }
+   static Pack broadcast(T const x) { Pack r; r.v = x; return r; }
+   void store(T* p) const { *p = v; }
+
+   /// Returns the sum of the elements
+   T sum() const { return v; }
+
+   friend Pack operator+(Pack a, Pack b) { a.v = a.v + b.v; return a; }
+   friend Pack operator-(Pack a, Pack b) { a.v = a.v - b.v; return a; }
+   friend Pack operator*(Pack a, Pack b) { a.v = a.v * b.v; return a; }
+   friend Pack operator/(Pack a, Pack b) { a.v = a.v / b.v; return a; }
+   friend Pack operator-(Pack a) { a.v = -a.v; return a; }
+};
+
+
+#if defined(LIBQCH5_SIMD_AVX512)
+
+template <>
+struct Pack<double> {
+
+   static size_t const Width = 8;
+
+   __m512d v;
+
+   static Pack load(double const* p) { Pack r; r.v = _mm512_loadu_pd(p); return r; }
+   static Pack broadcast(double const x) { Pack r; r.v = _mm512_set1_pd(x); return r; }
+   void store(double* p) const { _mm512_storeu_pd(p, v); }
+
+   double sum() const { return _mm512_reduce_add_pd(v); }
+
+   friend Pack operator+(Pack a, Pack b) { a.v = _mm512_add_pd(a.v, b.v); return a; }
+   friend Pack operator-(Pack a, Pack b) { a.v = _mm512_sub_pd(a.v, b.v); return a; }
+   friend Pack operator*(Pack a, Pack b) { a.v = _mm512_mul_pd(a.v, b.v); return a; }
+   friend Pack operator/(Pack a, Pack b) { a.v = _mm512_div_pd(a.v, b.v); return a; }
+   friend Pack operator-(Pack a) { a.v = _mm512_sub_pd(_mm512_setzero_pd(), a.v); return a; }
+};
+
+
+template <>
+struct Pack<float> {
+
+   static size_t const Width = 16;
+
+   __m512 v;
+
+   static Pack load(float const* p) { Pack r; r.v = _mm512_loadu_ps(p); return r; }
+   static Pack broadcast(float const x) { Pack r; r.v = _mm512_set1_ps(x); return r; }
+   void store(float* p) const { _mm512_storeu_ps(p, v); }
+
+   float sum() const { return _mm512_reduce_add_ps(v); }
+
+   friend Pack operator+(Pack a, Pack b) { a.v = _mm512_add_ps(a.v, b.v); return a; }
+   friend Pack operator-(Pack a, Pack b) { a.v = _mm512_sub_ps(a.v, b.v); return a; }
+   friend Pack operator*(Pack a, Pack b) { a.v = _mm512_mul_ps(a.v, b.v); return a; }
+   friend Pack operator/(Pack a, Pack b) { a.v = _mm512_div_ps(a.v, b.v); return a; }
+   friend Pack operator-(Pack a) { a.v = _mm512_sub_ps(_mm512_setzero_ps(), a.v); return a; }
+};
+
+#elif defined(LIBQCH5_SIMD_AVX2)
+
+template <>
+struct Pack<double> {
+
+   static size_t const Width = 4;
+
+   __m256d v;
+
+   static Pack load(double const* p) { Pack r; r.v = _mm256_loadu_pd(p); return r; }
+   static Pack broadcast(double const x) { Pack r; r.v = _mm256_set1_pd(x); return r; }
+   void store(double* p) const { _mm256_storeu_pd(p, v); }
+
+   double sum() const
+   {
+      __m128d s(_mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1)));
+      return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+   }
+
+   friend Pack operator+(Pack a, Pack b) { a.v = _mm256_add_pd(a.v, b.v); return a; }
+   friend Pack operator-(Pack a, Pack b) { a.v = _mm256_sub_pd(a.v, b.v); return a; }
+   friend Pack operator*(Pack a, Pack b) { a.v = _mm256_mul_pd(a.v, b.v); return a; }
+   friend Pack operator/(Pack a, Pack b) { a.v = _mm256_div_pd(a.v, b.v); return a; }
+   friend Pack operator-(Pack a) { a.v = _mm256_sub_pd(_mm256_setzero_pd(), a.v); return a; }
+};
+
+
+template <>
+struct Pack<float> {
+
+   static size_t const Width = 8;
+
+   __m256 v;
+
+   static Pack load(float const* p) { Pack r; r.v = _mm256_loadu_ps(p); return r; }
+   static Pack broadcast(float const x) { Pack r; r.v = _mm256_set1_ps(x); return r; }
+   void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+   float sum() const
+   {
+      __m128 s(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+      s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+      return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+   }
+
+   friend Pack operator+(Pack a, Pack b) { a.v = _mm256_add_ps(a.v, b.v); return a; }
+   friend Pack operator-(Pack a, Pack b) { a.v = _mm256_sub_ps(a.v, b.v); return a; }
+   friend Pack operator*(Pack a, Pack b) { a.v = _mm256_mul_ps(a.v, b.v); return a; }
+   friend Pack operator/(Pack a, Pack b) { a.v = _mm256_div_ps(a.v, b.v); return a; }
+   friend Pack operator-(Pack a) { a.v = _mm256_sub_ps(_mm256_setzero_ps(), a.v); return a; }
+};
+
+#endif
+
+} // end namespace
+
+#endif
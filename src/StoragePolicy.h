@@ -0,0 +1,128 @@
+#ifndef LIBQCH5_STORAGEPOLICY_H
+#define LIBQCH5_STORAGEPOLICY_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include "hdf5.h"
+#include "Types.h"
+
+
+namespace libqch5 {
+
+/** \brief Describes how an array is laid out on disk: chunk shape, shuffle and
+           deflate filters and the fill/allocation behaviour of the dataset.
+
+    \usage A default constructed policy is unset, meaning the array inherits
+           the default policy of the ProjectFile it is written to.
+
+           List<hsize_t> chunk;
+           chunk.push_back(256);
+           chunk.push_back(64);
+
+           StoragePolicy policy(StoragePolicy::Compressed(6));
+           policy.setChunk(chunk);
+           array.setStoragePolicy(policy);
+
+           project.setStoragePolicy(StoragePolicy::Compressed());
+
+           Chunk dimensions are given in the same order as the Array Size.  If
+           a filter is requested without a chunk shape, one is chosen so that
+           each chunk is no larger than ChunkBytes.
+
+           Floating point elements may be stored as a different floating
+           point type, which HDF5 converts to on writing and back on
+           reading.  The array is read back with its original element type:
+
+           StoragePolicy policy;
+           policy.setFileType(H5T_NATIVE_FLOAT);   // double data, half the I/O
+
+           Integer and complex arrays are always stored as their own type.
+ **/
+
+class StoragePolicy {
+
+   public:
+      enum AllocTime { AllocDefault, AllocEarly, AllocIncremental, AllocLate };
+      enum FillTime  { FillIfSet, FillAlloc, FillNever };
+
+      /// Target upper bound for automatically determined chunks.
+      static size_t const ChunkBytes = 1 << 20;
+
+      StoragePolicy();
+
+      /// Contiguous, uncompressed storage.  This is the HDF5 default.
+      static StoragePolicy Contiguous();
+
+      /// Chunked storage with the shuffle filter and deflate at the given level.
+      static StoragePolicy Compressed(unsigned level = 4);
+
+      bool isSet() const { return m_set; }
+
+      void setChunk(List<hsize_t> const& chunk) { m_chunk = chunk; m_set = true; }
+      List<hsize_t> const& chunk() const { return m_chunk; }
+
+      void setShuffle(bool shuffle) { m_shuffle = shuffle; m_set = true; }
+      bool shuffle() const { return m_shuffle; }
+
+      /// Sets the deflate (gzip) level, 0-9.  A level of 0 disables compression.
+      void setDeflate(unsigned level) { m_deflate = level > 9 ? 9 : level; m_set = true; }
+      unsigned deflate() const { return m_deflate; }
+
+      void setAllocTime(AllocTime allocTime) { m_allocTime = allocTime; m_set = true; }
+      AllocTime allocTime() const { return m_allocTime; }
+
+      void setFillTime(FillTime fillTime) { m_fillTime = fillTime; m_set = true; }
+      FillTime fillTime() const { return m_fillTime; }
+
+      /// Sets the value of unwritten elements, e.g. the regions of extendible
+      /// datasets that have not yet been written.  This is converted to the
+      /// element type and applies only to integer and floating point arrays.
+      void setFillValue(double value)
+      {
+         m_fillValue = value; m_hasFillValue = true; m_set = true;
+      }
+      bool hasFillValue() const { return m_hasFillValue; }
+      double fillValue() const { return m_fillValue; }
+
+      /// Sets the element type on disk of floating point arrays, or -1 (the
+      /// default) to store the array type.  This must be one of the native
+      /// floating point types of H5Utils.h.
+      void setFileType(hid_t type) { m_fileType = type; m_set = true; }
+      hid_t fileType() const { return m_fileType; }
+
+      /// Chunking is required if a chunk shape or any filter has been requested.
+      bool chunked() const { return !m_chunk.empty() || m_shuffle || m_deflate > 0; }
+
+      /// Creates a dataset creation property list implementing the policy for
+      /// a dataset of the given rank, dimensions and element type on disk.
+      /// Dimensions are given in file (row major) order, i.e. reversed with
+      /// respect to the chunk shape, which follows the Array Size ordering.
+      /// If given, chunks are not limited by the current extent of unlimited
+      /// maxDimensions.  Datasets with a fixed extent of zero cannot be
+      /// chunked and are stored contiguously without filters.  The caller is
+      /// responsible for closing the returned handle, which is negative on
+      /// failure.
+      hid_t createPropertyList(size_t rank, hsize_t const* dimensions,
+         hid_t fileType, hsize_t const* maxDimensions = 0) const;
+
+   private:
+      bool          m_set;
+      List<hsize_t> m_chunk;
+      bool          m_shuffle;
+      unsigned      m_deflate;
+      AllocTime     m_allocTime;
+      FillTime      m_fillTime;
+      bool          m_hasFillValue;
+      double        m_fillValue;
+      hid_t         m_fileType;
+};
+
+} // end namespace
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef LIBQCH5_STRUCTURE_H
+#define LIBQCH5_STRUCTURE_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include "hdf5.h"
+
+
+namespace libqch5 {
+
+/** \brief Storage scheme of an array, which determines how the data in file
+           map to the elements of the array.
+
+    \usage Arrays other than Dense are tagged with a string attribute named
+           Structure so that RawData::read can restore the right type.
+           Datasets without the attribute are Dense.
+
+           Symmetric   The lower triangle of an n by n symmetric matrix,
+                       packed row by row into a rank 1 dataset of
+                       n(n+1)/2 elements (see SymmetricArray.h).
+
+           BlockSparse A group holding an n by rank Index dataset of the
+                       grid coordinates of the n stored blocks and a rank 1
+                       Values dataset of their concatenated elements, with
+                       the Dimensions and BlockSize as attributes (see
+                       BlockSparse.h).
+ **/
+
+class Structure {
+
+   public:
+      enum Id { Dense, Symmetric, BlockSparse };
+
+      static char const* toString(Id const);
+
+      /// Returns the structure recorded for the object oid.
+      static Id read(hid_t oid);
+
+      /// Records the structure for the object path in the group gid.  No
+      /// attribute is written for Dense arrays.
+      static bool write(hid_t gid, char const* path, Id const);
+
+   private:
+      static char const* AttributeName;
+};
+
+} // end namespace
+
+#endif
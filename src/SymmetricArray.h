@@ -0,0 +1,280 @@
+#ifndef LIBQCH5_SYMMETRICARRAY_H
+#define LIBQCH5_SYMMETRICARRAY_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include "Array.h"
+#include "Simd.h"
+#include "Transpose.h"
+
+
+namespace libqch5 {
+
+/** \brief Symmetric n by n matrix of which only the lower triangle is stored,
+           packed row by row, for example Fock, density and overlap matrices.
+
+    \usage Element (i,j) with i >= j is held at index i(i+1)/2 + j of the
+           packed data, which is also the upper triangle packed column by
+           column as used by the LAPACK 'U' routines.  Either triangle may be
+           addressed:
+
+           SymmetricArray<> fock(nBasis);
+           fock(0, 1) = fock(1, 0) = -0.25;   // same element
+
+           Array<2> full;
+           fock.unpack(full);                 // both triangles
+           fock.multiply(c, fc);              // fc = F.c
+
+           Only the n(n+1)/2 packed elements are written by RawData, as a
+           rank 1 dataset tagged with Structure::Symmetric, and a
+           SymmetricArray is returned when the data are read back.
+
+    \param T the type of data stored in the array
+    \param Alloc the allocator for the packed data, see Allocator.h
+ **/
+
+template < typename T = double, typename Alloc = AlignedAllocator<T> >
+class SymmetricArray : public ArrayBase {
+
+   public:
+      SymmetricArray(size_t n = 0, Alloc const& alloc = Alloc())
+       : m_data(0), m_n(0), m_length(0), m_alloc(alloc) { resize(n); }
+
+      /// Packs the lower triangle of the square matrix full.
+      template <typename A, typename O>
+      explicit SymmetricArray(Array<2, T, A, O> const& full, Alloc const& alloc = Alloc())
+       : m_data(0), m_n(0), m_length(0), m_alloc(alloc) { pack(full); }
+
+      SymmetricArray(SymmetricArray const& that)
+       : ArrayBase(that), m_data(0), m_n(0), m_length(0), m_alloc(that.m_alloc)
+      {
+         copy(that);
+      }
+
+      /// Takes over the data of that, leaving it empty.
+      SymmetricArray(SymmetricArray&& that)
+       : ArrayBase(that), m_data(0), m_n(0), m_length(0), m_alloc(that.m_alloc)
+      {
+         take(that);
+      }
+
+      ~SymmetricArray() { destroy(); }
+
+      SymmetricArray& operator=(SymmetricArray const& that)
+      {
+          if (this != &that) {
+             ArrayBase::operator=(that);
+             copy(that);
+          }
+          return *this;
+      }
+
+      SymmetricArray& operator=(SymmetricArray&& that)
+      {
+          if (this != &that) {
+             destroy();
+             ArrayBase::operator=(that);
+             m_alloc = that.m_alloc;
+             take(that);
+          }
+          return *this;
+      }
+
+      SymmetricArray* clone() const { return new SymmetricArray(*this); }
+
+      /// Resizes to an n by n matrix.  As for Array, the contents are
+      /// undefined after a resize.
+      void resize(size_t n)
+      {
+         size_t const length(packedLength(n));
+         if (length != m_length) {
+            if (m_data) m_alloc.deallocate(m_data, m_length);
+            m_data   = 0;
+            m_data   = m_alloc.allocate(length);
+            m_length = length;
+         }
+         m_n = n;
+      }
+
+      void init() { if (m_data) memset(m_data, 0, m_length*sizeof(T)); }
+
+      /// Rank of the stored data, which are packed into a single dimension.
+      size_t rank() const { return 1; }
+
+      /// Number of rows (and columns) of the matrix
+      size_t dim() const { return m_n; }
+
+      /// Number of packed elements, n(n+1)/2
+      size_t length() const { return m_length; }
+
+      static size_t packedLength(size_t n) { return n*(n+1)/2; }
+
+      /// Returns the packed index of element (i,j), in either triangle.
+      static size_t index(size_t i, size_t j)
+      {
+         return i >= j ? i*(i+1)/2 + j : j*(j+1)/2 + i;
+      }
+
+      T& operator()(size_t i, size_t j) { return m_data[index(i, j)]; }
+      T const& operator()(size_t i, size_t j) const { return m_data[index(i, j)]; }
+
+      // Direct access to the packed data
+      T& operator[](size_t k) { return m_data[k]; }
+      T const& operator[](size_t k) const { return m_data[k]; }
+
+      Structure::Id structure() const { return Structure::Symmetric; }
+
+      /// Packs the lower triangle of the square matrix full, returning false
+      /// if it is not square.
+      template <typename A, typename O>
+      bool pack(Array<2, T, A, O> const& full)
+      {
+         if (full.dim(0) != full.dim(1)) {
+            LOG_WARN("SymmetricArray requires a square matrix");
+            return false;
+         }
+
+         // Element (i,j), j <= i, is at i + j*n, or i*n + j if row major
+         size_t const n(full.dim(0));
+         size_t const si(full.strides()[0]), sj(full.strides()[1]);
+         resize(n);
+         if (n == 0) return true;
+
+         for (size_t i = 0; i < n; ++i) {
+             T* row(m_data + i*(i+1)/2);
+             T const* src(&full[0] + i*si);
+             for (size_t j = 0; j <= i; ++j) row[j] = src[j*sj];
+         }
+         return true;
+      }
+
+      /// Expands into the full n by n matrix.  The result is the same in
+      /// either Order.  Packed row i is first copied to column i, giving
+      /// the upper triangle with unit stride, then the upper triangle is
+      /// reflected into the lower in tiles of TransposeBlock.
+      template <typename A, typename O>
+      void unpack(Array<2, T, A, O>& full) const
+      {
+         size_t const n(m_n);
+         typename Array<2, T, A, O>::Size size = {{ n, n }};
+         full.resize(size);
+         if (n == 0) return;
+
+         T* f(&full[0]);
+         for (size_t i = 0; i < n; ++i) {
+             T const* row(m_data + i*(i+1)/2);
+             std::copy(row, row+i+1, f + i*n);
+         }
+
+         for (size_t jb = 0; jb < n; jb += TransposeBlock) {
+             size_t const je(std::min(jb+TransposeBlock, n));
+             for (size_t ib = jb; ib < n; ib += TransposeBlock) {
+                 size_t const ie(std::min(ib+TransposeBlock, n));
+                 for (size_t j = jb; j < je; ++j) {
+                     T* column(f + j*n);
+                     for (size_t i = std::max(ib, j+1); i < ie; ++i) {
+                         column[i] = f[j + i*n];
+                     }
+                 }
+             }
+         }
+      }
+
+      /// Sets y = A x for vectors of length n, streaming through the packed
+      /// data once.  Each packed row i contributes a dot product to y[i]
+      /// and an axpy to y[0..i), both evaluated Pack<T>::Width at a time.
+      /// x and y must not overlap.
+      void multiply(T const* x, T* y) const
+      {
+         size_t const width(Pack<T>::Width);
+         std::fill(y, y+m_n, T(0));
+
+         for (size_t i = 0; i < m_n; ++i) {
+             T const* row(m_data + i*(i+1)/2);
+             T const xi(x[i]);
+             T s(0);
+             size_t j(0);
+
+             if (width > 1 && i >= width) {
+                Pack<T> const bxi(Pack<T>::broadcast(xi));
+                Pack<T> acc(Pack<T>::broadcast(0));
+                for (; j + width <= i; j += width) {
+                    Pack<T> const a(Pack<T>::load(row+j));
+                    acc = acc + a*Pack<T>::load(x+j);
+                    (Pack<T>::load(y+j) + bxi*a).store(y+j);
+                }
+                s = acc.sum();
+             }
+
+             for (; j < i; ++j) {
+                 s    += row[j]*x[j];
+                 y[j] += xi*row[j];
+             }
+             y[i] += s + row[i]*xi;
+         }
+      }
+
+      /// As above, resizing y.  Returns false if x is not of length n.
+      template <typename A1, typename O1, typename A2, typename O2>
+      bool multiply(Array<1, T, A1, O1> const& x, Array<1, T, A2, O2>& y) const
+      {
+         if (x.length() != m_n) {
+            LOG_WARN("SymmetricArray::multiply dimension mismatch");
+            return false;
+         }
+
+         typename Array<1, T, A2, O2>::Size size = {{ m_n }};
+         y.resize(size);
+         if (m_n) multiply(&x[0], &y[0]);
+         return true;
+      }
+
+
+   protected:
+      hid_t h5DataType() const { return H5DataType(T()); }
+
+      void* buffer() { return m_data; }
+      void const* buffer() const { return m_data; }
+
+      size_t const* dimensions() const { return &m_length; }
+
+   private:
+      void copy(SymmetricArray const& that)
+      {
+         resize(that.m_n);
+         if (m_length) memcpy(m_data, that.m_data, m_length*sizeof(T));
+      }
+
+      void destroy()
+      {
+         if (m_data) m_alloc.deallocate(m_data, m_length);
+         m_data   = 0;
+         m_n      = 0;
+         m_length = 0;
+      }
+
+      void take(SymmetricArray& that)
+      {
+         m_data   = that.m_data;
+         m_n      = that.m_n;
+         m_length = that.m_length;
+         that.m_data   = 0;
+         that.m_n      = 0;
+         that.m_length = 0;
+      }
+
+      T*     m_data;
+      size_t m_n;
+      size_t m_length;  // also the allocated length
+      Alloc  m_alloc;
+};
+
+} // end namespace
+
+#endif
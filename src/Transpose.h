@@ -0,0 +1,342 @@
+#ifndef LIBQCH5_TRANSPOSE_H
+#define LIBQCH5_TRANSPOSE_H
+/*******************************************************************************
+
+  This file is part of libqch5 a data file format for managing quantum
+  chemistry projects.
+
+  Copyright (C) 2018 Andrew Gilbert
+
+********************************************************************************/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+
+namespace libqch5 {
+
+/// Edge length of the tiles used by permute(), chosen so that a tile of the
+/// source and destination both fit comfortably in L1 cache.
+size_t const TransposeBlock = 32;
+
+/// Extent of the output axis handled by each unit of work.  A strip of
+/// TransposeBlock by TransposePanel elements of the source and destination
+/// stays resident in L2 while its tiles are copied.
+size_t const TransposePanel = 8*TransposeBlock;
+
+/// Arrays with fewer elements than this are always permuted by the calling
+/// thread, as starting threads would cost more than the copy.
+size_t const TransposeParallelLength = 1 << 16;
+
+
+/// Returns true if perm holds each of 0 ... rank-1 exactly once.
+bool isPermutation(size_t rank, size_t const* perm);
+
+
+namespace Transpose {
+
+/// Simplified form of a permutation.  Axes of unit extent are dropped and
+/// runs of axes that are adjacent in both the input and output are merged,
+/// so that, for example, permuting (ij|kl) to (kl|ij) becomes a 2D
+/// transpose.
+struct Plan {
+   Plan(size_t rank, size_t const* shape, size_t const* axes);
+   std::vector<size_t> dims;
+   std::vector<size_t> perm;
+   size_t length;
+};
+
+
+/// Steps through the column major multi-index of a set of axes and tracks
+/// the corresponding offsets into two arrays.
+class Odometer {
+
+   public:
+      Odometer() : in(0), out(0), m_count(1) { }
+
+      void addAxis(size_t dim, size_t inStride, size_t outStride)
+      {
+         m_dims.push_back(dim);
+         m_inStride.push_back(inStride);
+         m_outStride.push_back(outStride);
+         m_idx.push_back(0);
+         m_count *= dim;
+      }
+
+      /// Number of distinct positions
+      size_t count() const { return m_count; }
+
+      /// Moves to the n-th position
+      void seek(size_t n)
+      {
+         in = out = 0;
+         for (size_t a = 0; a < m_dims.size(); ++a) {
+             m_idx[a] = n % m_dims[a];
+             n /= m_dims[a];
+             in  += m_idx[a]*m_inStride[a];
+             out += m_idx[a]*m_outStride[a];
+         }
+      }
+
+      void next()
+      {
+         for (size_t a = 0; a < m_dims.size(); ++a) {
+             in  += m_inStride[a];
+             out += m_outStride[a];
+             if (++m_idx[a] < m_dims[a]) return;
+             in  -= m_dims[a]*m_inStride[a];
+             out -= m_dims[a]*m_outStride[a];
+             m_idx[a] = 0;
+         }
+      }
+
+      size_t in;
+      size_t out;
+
+   private:
+      std::vector<size_t> m_dims;
+      std::vector<size_t> m_inStride;
+      std::vector<size_t> m_outStride;
+      std::vector<size_t> m_idx;
+      size_t m_count;
+};
+
+
+/// Calls f(begin, end) over contiguous ranges covering [0, count), using up
+/// to the given number of threads.  Zero threads means one per core.
+template <typename F>
+void parallelFor(size_t count, unsigned threads, F const& f)
+{
+   if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+   if (threads > count) threads = count;
+
+   if (threads <= 1) {
+      if (count) f(size_t(0), count);
+      return;
+   }
+
+   std::vector<std::thread> pool;
+   size_t const chunk(count/threads), extra(count%threads);
+   size_t begin(0);
+
+   for (unsigned t = 0; t < threads; ++t) {
+       size_t const end(begin + chunk + (t < extra ? 1 : 0));
+       if (t+1 < threads) {
+          pool.push_back(std::thread(f, begin, end));
+       }else {
+          f(begin, end);
+       }
+       begin = end;
+   }
+
+   for (size_t t = 0; t < pool.size(); ++t) pool[t].join();
+}
+
+
+/// Copies dst[j + i*so] = src[i + j*si] for i < n0 and j0 <= j < j1, in
+/// tiles of TransposeBlock.
+template <typename T>
+void transposePanel(T const* src, T* dst, size_t n0, size_t j0, size_t j1,
+   size_t si, size_t so)
+{
+   for (size_t ib = 0; ib < n0; ib += TransposeBlock) {
+       size_t const ie(std::min(ib+TransposeBlock, n0));
+       for (size_t jb = j0; jb < j1; jb += TransposeBlock) {
+           size_t const je(std::min(jb+TransposeBlock, j1));
+           for (size_t j = jb; j < je; ++j) {
+               T const* s(src + j*si);
+               T* d(dst + j);
+               for (size_t i = ib; i < ie; ++i) {
+                   d[i*so] = s[i];
+               }
+           }
+       }
+   }
+}
+
+
+/// Exchanges axes a < b, of equal extent, of the column major array data.
+template <typename T>
+void swapAxes(T* data, size_t rank, size_t const* dims, size_t a, size_t b,
+   unsigned threads)
+{
+   size_t const n(dims[a]);
+   size_t stride(1), sa(0), sb(0), length(1);
+   Odometer outer;
+
+   for (size_t k = 0; k < rank; ++k) {
+       if (k == a) {
+          sa = stride;
+       }else if (k == b) {
+          sb = stride;
+       }else {
+          outer.addAxis(dims[k], stride, 0);
+       }
+       stride *= dims[k];
+       length *= dims[k];
+   }
+
+   // Each unit of work is a row of tiles on or above the diagonal
+   size_t const rows((n + TransposeBlock - 1)/TransposeBlock);
+   if (length < TransposeParallelLength) threads = 1;
+
+   parallelFor(rows*outer.count(), threads, [&](size_t begin, size_t end) {
+      Odometer position(outer);
+      position.seek(begin / rows);
+      size_t row(begin % rows);
+
+      for (size_t item = begin; item < end; ++item) {
+          T* p(data + position.in);
+          size_t const xb(row*TransposeBlock), xe(std::min(xb+TransposeBlock, n));
+
+          for (size_t yb = xb; yb < n; yb += TransposeBlock) {
+              size_t const ye(std::min(yb+TransposeBlock, n));
+              for (size_t x = xb; x < xe; ++x) {
+                  for (size_t y = std::max(yb, x+1); y < ye; ++y) {
+                      std::swap(p[x*sa + y*sb], p[y*sa + x*sb]);
+                  }
+              }
+          }
+
+          if (++row == rows) {
+             row = 0;
+             position.next();
+          }
+      }
+   });
+}
+
+} // end namespace Transpose
+
+
+/** \brief Reorders the axes of the column major array in, with dimensions
+           dims, into out.  Axis i of out is axis perm[i] of in.  The two
+           fastest varying axes of in and out are traversed in tiles of
+           TransposeBlock so that both arrays are accessed cache-wise.  The
+           arrays must not overlap.
+
+    \usage Large arrays may be split across several threads, 0 requests one
+           per core.  The (ij|kl) to (ik|jl) reordering of a 4-index tensor
+           in column major order is:
+
+           size_t dims[] = { n, n, n, n };
+           size_t perm[] = { 0, 2, 1, 3 };
+           permute(in, out, 4, dims, perm, 0);
+ **/
+
+template <typename T>
+void permute(T const* in, T* out, size_t rank, size_t const* dims, size_t const* perm,
+   unsigned threads = 1)
+{
+   Transpose::Plan const plan(rank, dims, perm);
+   size_t const r(plan.dims.size());
+   if (plan.length == 0) return;
+
+   if (plan.length < TransposeParallelLength) threads = 1;
+
+   if (r <= 1) {
+      Transpose::parallelFor(plan.length, threads, [&](size_t begin, size_t end) {
+         std::copy(in+begin, in+end, out+begin);
+      });
+      return;
+   }
+
+   // Strides of each input axis in the input and output arrays
+   std::vector<size_t> inStride(r), outStride(r);
+   size_t stride(1);
+   for (size_t k = 0; k < r; ++k) {
+       inStride[k] = stride;
+       stride *= plan.dims[k];
+   }
+
+   stride = 1;
+   for (size_t i = 0; i < r; ++i) {
+       outStride[plan.perm[i]] = stride;
+       stride *= plan.dims[plan.perm[i]];
+   }
+
+   // Axis 0 is fastest in the input, q in the output.  The remaining axes
+   // are iterated over in the outer loop.
+   size_t const q(plan.perm[0]);
+   Transpose::Odometer outer;
+   for (size_t k = 1; k < r; ++k) {
+       if (k != q) outer.addAxis(plan.dims[k], inStride[k], outStride[k]);
+   }
+
+   size_t const n0(plan.dims[0]), nq(plan.dims[q]);
+   size_t const si(inStride[q]), so(outStride[0]);
+   size_t const panels(q == 0 ? 1 : (nq + TransposePanel - 1)/TransposePanel);
+
+   Transpose::parallelFor(panels*outer.count(), threads, [&](size_t begin, size_t end) {
+      Transpose::Odometer position(outer);
+      position.seek(begin / panels);
+      size_t panel(begin % panels);
+
+      for (size_t item = begin; item < end; ++item) {
+          T const* src(in + position.in);
+          T* dst(out + position.out);
+
+          if (q == 0) {
+             std::copy(src, src+n0, dst);
+          }else {
+             size_t const j0(panel*TransposePanel);
+             Transpose::transposePanel(src, dst, n0, j0,
+                std::min(j0+TransposePanel, nq), si, so);
+          }
+
+          if (++panel == panels) {
+             panel = 0;
+             position.next();
+          }
+      }
+   });
+}
+
+
+/** \brief Reorders the axes of the column major array data in place, which
+           requires that the extents are unchanged, i.e. dims[perm[i]] ==
+           dims[i], as for the transpose of a square matrix.  The
+           permutation is applied as a sequence of blocked exchanges of pairs
+           of axes.  Returns false, leaving data untouched, if the
+           permutation does not preserve the extents.
+ **/
+
+template <typename T>
+bool permuteInPlace(T* data, size_t rank, size_t const* dims, size_t const* perm,
+   unsigned threads = 1)
+{
+   if (!isPermutation(rank, perm)) return false;
+   for (size_t i = 0; i < rank; ++i) {
+       if (dims[perm[i]] != dims[i]) return false;
+   }
+
+   // current[i] is the original axis now at position i
+   std::vector<size_t> current(rank);
+   for (size_t i = 0; i < rank; ++i) current[i] = i;
+
+   for (size_t i = 0; i < rank; ++i) {
+       if (current[i] == perm[i]) continue;
+       size_t j(i+1);
+       while (current[j] != perm[i]) ++j;
+       Transpose::swapAxes(data, rank, dims, i, j, threads);
+       std::swap(current[i], current[j]);
+   }
+
+   return true;
+}
+
+
+/// As above for elements of the given size in bytes, for use where the
+/// element type is only known at run time.
+void permute(void const* in, void* out, size_t elementSize, size_t rank,
+   size_t const* dims, size_t const* perm, unsigned threads = 1);
+
+bool permuteInPlace(void* data, size_t elementSize, size_t rank,
+   size_t const* dims, size_t const* perm, unsigned threads = 1);
+
+} // end namespace
+
+#endif